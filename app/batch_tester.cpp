@@ -0,0 +1,262 @@
+// runs an engine over many generated boards using all cores
+// and writes one csv line per board:
+// seed;size;engine;casts;valid;millis;peak_rss_kb;layers
+//
+// -e : engine name: bs, bs_v7, bs_int, bs_balanced, bs_new, bs_replay, naive
+// -seed_min, -seed_max : seed range, both inclusive
+// -sz_min, -sz_max : board size is picked from this range by seed rng, 50..100 by default
+// -w : beam width, 500*(100/sz)^2 by default
+// -ms : time per board, engines with deadline finish right before it
+// -t : number of threads, all cores by default
+// -et : threads of one engine run, only bs_new uses them, 1 by default
+// -dm : megabytes for discovered boards of bs_new, 64 by default
+// -o : output csv path, stdout by default
+// -trace : file for layer trace of every board, build with FRAGMIR_TRACE
+//
+// every board is solved in a forked process, peak_rss_kb is peak of that
+// process alone: the solve plus the few megabytes the tester has at fork
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <atomic>
+#include <map>
+
+#include "ant/core/core.hpp"
+
+#include "util.hpp"
+#include "score.hpp"
+#include "board_v1_impl_1.hpp"
+#include "board_v6.hpp"
+#include "board_v7.hpp"
+#include "beam_search.hpp"
+#include "bs_balanced.hpp"
+#include "bs_new.hpp"
+#include "beam_search_replay.hpp"
+#include "naive_search.hpp"
+#include "worker_pool.hpp"
+
+
+struct Settings {
+    Count beam_width;
+    Count millis;
+    Count thread_count;
+    Count discovery_mb;
+};
+
+struct Solution {
+    vector<Position> casts;
+    Count layers;
+    // only beam engines with layers keep it
+    SolveTrace trace;
+};
+
+using Engine = function<Solution(const StrBoard&, const Settings&)>;
+
+
+template<class Board, class Score = Score_v1>
+Solution SolveBeamSearch(const StrBoard& str_board, const Settings& s) {
+    BeamSearch<Board, Score> solver;
+    solver.set_beam_width(s.beam_width);
+    if (s.millis > 0) solver.set_deadline(std::chrono::milliseconds(s.millis));
+    auto b = solver.Destroy(str_board);
+    return {b.CastHistory(), solver.layer_count(), solver.trace()};
+}
+
+Solution SolveBeamSearchBalanced(const StrBoard& str_board, const Settings& s) {
+    BeamSearchBalanced<Board_v6, Score_v1> solver;
+    solver.set_beam_width(s.beam_width);
+    if (s.millis > 0) solver.set_time(std::chrono::seconds((s.millis + 999) / 1000));
+    auto b = solver.Destroy(str_board);
+    return {b.CastHistory(), solver.layer_count(), solver.trace()};
+}
+
+Solution SolveBeamSearchNew(const StrBoard& str_board, const Settings& s) {
+    BeamSearchNew<Board_v6> solver;
+    solver.set_beam_width(s.beam_width);
+    if (s.millis > 0) solver.set_millis(s.millis);
+    solver.set_thread_count(s.thread_count);
+    solver.set_discovery_memory(size_t(s.discovery_mb) << 20);
+    auto b = solver.Destroy(str_board);
+    return {b.CastHistory(), 0, {}};
+}
+
+Solution SolveBeamSearchReplay(const StrBoard& str_board, const Settings& s) {
+    BeamSearchReplay<Board_v6, Score_v1> solver;
+    solver.set_beam_width(s.beam_width);
+    if (s.millis > 0) solver.set_time(std::chrono::seconds((s.millis + 999) / 1000));
+    auto b = solver.Destroy(str_board);
+    return {b.CastHistory(), solver.layer_count(), {}};
+}
+
+Solution SolveNaive(const StrBoard& str_board, const Settings& s) {
+    Score_v1 score;
+    auto b = NaiveSearch<Board_v6, Score_v1>().Destroy(str_board, score);
+    return {b.CastHistory(), 0, {}};
+}
+
+const map<string, Engine> kEngines = {
+    {"bs", SolveBeamSearch<Board_v6>},
+    {"bs_v7", SolveBeamSearch<Board_v7>},
+    {"bs_int", SolveBeamSearch<Board_v6, Score_v1_Int>},
+    {"bs_balanced", SolveBeamSearchBalanced},
+    {"bs_new", SolveBeamSearchNew},
+    {"bs_replay", SolveBeamSearchReplay},
+    {"naive", SolveNaive}
+};
+
+
+struct Record {
+    Index seed;
+    Count size;
+    Count casts;
+    bool valid;
+    int64_t millis;
+    long peak_rss_kb;
+    Count layers;
+    SolveTrace trace;
+};
+
+bool IsValid(const StrBoard& str_board, const vector<Position>& casts) {
+    Board_v1_Impl_1<CastHistory_Nodes> b = str_board;
+    for (auto& p : casts) b.Cast(p);
+    return b.AllDestroyed();
+}
+
+bool WriteAll(int fd, const void* data, size_t size) {
+    auto p = static_cast<const char*>(data);
+    while (size > 0) {
+        auto n = write(fd, p, size);
+        if (n <= 0) return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool ReadAll(int fd, void* data, size_t size) {
+    auto p = static_cast<char*>(data);
+    while (size > 0) {
+        auto n = read(fd, p, size);
+        if (n <= 0) return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+template<class T>
+bool WriteVector(int fd, const vector<T>& v) {
+    Count sz = v.size();
+    return WriteAll(fd, &sz, sizeof(sz)) && WriteAll(fd, v.data(), sz * sizeof(T));
+}
+
+template<class T>
+bool ReadVector(int fd, vector<T>& v) {
+    Count sz;
+    if (!ReadAll(fd, &sz, sizeof(sz))) return false;
+    v.resize(sz);
+    return ReadAll(fd, v.data(), sz * sizeof(T));
+}
+
+// child solves and sends solution back through the pipe, rusage of the
+// child alone is taken when it's waited for.
+// solution of a child that died is empty, so it's not valid
+Solution SolveInChild(const Engine& engine, const StrBoard& str_board, const Settings& s, long& peak_rss_kb) {
+    Solution sol{{}, 0, {}};
+    peak_rss_kb = 0;
+    int fds[2];
+    if (pipe(fds) != 0) return sol;
+    auto pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        auto res = engine(str_board, s);
+        bool ok = WriteVector(fds[1], res.casts) && WriteAll(fds[1], &res.layers, sizeof(res.layers))
+                  && WriteVector(fds[1], res.trace.layers());
+        // destructors of the parent state aren't for the child
+        _exit(ok ? 0 : 1);
+    }
+    close(fds[1]);
+    if (pid < 0) {
+        close(fds[0]);
+        return sol;
+    }
+    vector<LayerTrace> layers;
+    if (!ReadVector(fds[0], sol.casts) || !ReadAll(fds[0], &sol.layers, sizeof(sol.layers))
+        || !ReadVector(fds[0], layers)) {
+        sol.casts.clear();
+    }
+    for (auto& t : layers) sol.trace.NewLayer() = t;
+    close(fds[0]);
+    int status;
+    rusage usage;
+    if (wait4(pid, &status, 0, &usage) == pid) peak_rss_kb = usage.ru_maxrss;
+    return sol;
+}
+
+int main(int argc, const char * argv[]) {
+    command_line_parser parser(argv, argc);
+    auto value = [&](const string& key, int default_value) {
+        return parser.exists(key) ? ant::atoi(parser.getValue(key)) : default_value;
+    };
+    string engine_name = parser.exists("e") ? parser.getValue("e") : "bs";
+    if (kEngines.count(engine_name) == 0) {
+        cerr << "unknown engine: " << engine_name << endl;
+        return 1;
+    }
+    auto& engine = kEngines.at(engine_name);
+    int seed_min = value("seed_min", 1);
+    int seed_max = value("seed_max", 100);
+    int sz_min = value("sz_min", 50);
+    int sz_max = value("sz_max", 100);
+    int width = value("w", 0);
+    int millis = value("ms", 0);
+    int thread_count = value("t", max<int>(1, thread::hardware_concurrency()));
+    int engine_thread_count = value("et", 1);
+    int discovery_mb = value("dm", 64);
+
+    vector<Record> records(seed_max - seed_min + 1);
+    atomic<Index> next_record{0};
+    WorkerPool pool(thread_count);
+    pool.Run([&](Index worker) {
+        for (Index i; (i = next_record++) < records.size();) {
+            auto& r = records[i];
+            r.seed = seed_min + i;
+            // small seeds give close first outputs when used directly
+            seed_seq seq{r.seed};
+            default_random_engine rng(seq);
+            r.size = uniform_int_distribution<>(sz_min, sz_max)(rng);
+            auto str_board = GenerateStringBoard(r.size, rng);
+
+            Settings s;
+            s.beam_width = width > 0 ? width : 500. * pow(100. / r.size, 2);
+            s.millis = millis;
+            s.thread_count = engine_thread_count;
+            s.discovery_mb = discovery_mb;
+            auto start = GetMillisCount();
+            auto sol = SolveInChild(engine, str_board, s, r.peak_rss_kb);
+            r.millis = GetMillisCount() - start;
+            r.casts = sol.casts.size();
+            r.layers = sol.layers;
+            r.trace = move(sol.trace);
+            r.valid = IsValid(str_board, sol.casts);
+        }
+    });
+
+    ofstream fout;
+    ostream* out = &cout;
+    if (parser.exists("o")) {
+        fout.open(parser.getValue("o"));
+        out = &fout;
+    }
+    *out << "seed;size;engine;casts;valid;millis;peak_rss_kb;layers" << endl;
+    for (auto& r : records) {
+        *out << r.seed << ";" << r.size << ";" << engine_name << ";" << r.casts << ";" << r.valid << ";"
+             << r.millis << ";" << r.peak_rss_kb << ";" << r.layers << endl;
+    }
+    if (parser.exists("trace")) {
+        ofstream trace(parser.getValue("trace"));
+        SolveTrace::PrintHeader(trace);
+        for (auto& r : records) r.trace.Print(trace, to_string(r.seed));
+    }
+}
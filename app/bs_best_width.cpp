@@ -3,6 +3,8 @@
 // -max_w : maximum width bound
 // -n : number of boards to test
 // -s : seconds per solution
+// -t : number of threads used by beam search
+// -trace : file for layer trace of every solve, build with FRAGMIR_TRACE
 #include "ant/core/core.hpp"
 
 #include "beam_search.hpp"
@@ -11,10 +13,11 @@
 
 
 template<class Board, class Solver>
-int ComputeMaxWidth(const Board& b, Solver& s, int minWidth, int maxWidth) {
+int ComputeMaxWidth(const Board& b, Solver& s, int minWidth, int maxWidth, ostream* trace, const string& name) {
 	auto cond = [&](int width) {
 		s.set_beam_width(width);
 		auto r = s.Destroy(b);
+		if (trace) s.trace().Print(*trace, name + ":" + to_string(width));
 		return r.CastCount() != 0;
 	};
 	return ant::LogicalBinarySearch<int, decltype(cond)>::Max(minWidth, maxWidth, cond);
@@ -33,13 +36,24 @@ int main(int argc, const char * argv[]) {
 	if (parser.exists("s")) {
 		time = decltype(time){atoi(parser.getValue("s"))};
 	}
+	int threadCount = 1;
+	if (parser.exists("t")) {
+		threadCount = atoi(parser.getValue("t"));
+	}
+
+	ofstream trace;
+	if (parser.exists("trace")) {
+		trace.open(parser.getValue("trace"));
+		SolveTrace::PrintHeader(trace);
+	}
 
 	ant::Stats stats;
 	for (size_t i = 0; i < boardCountPerCase; ++i) {
 		BeamSearch<Board_v6, Score_v1> solver;
 		solver.set_time(time);
+		solver.set_thread_count(threadCount);
 		Board_v6 orig = GenerateStringBoard(sz);
-		stats.add(ComputeMaxWidth(orig, solver, minWidth, maxWidth));
+		stats.add(ComputeMaxWidth(orig, solver, minWidth, maxWidth, trace.is_open() ? &trace : nullptr, to_string(i)));
 	}
 	Println(std::cout, "Mix width: ", (int)stats.min());
 	Println(std::cout, "Max width: ", (int)stats.max());
@@ -10,6 +10,7 @@
 
 #include "board_v1_impl_1.hpp"
 #include "board_v6.hpp"
+#include "board_v6_fixed.hpp"
 
 #include "bs_new.hpp"
 #include "naive_search.hpp"
@@ -19,9 +20,12 @@
 #include "fragile_mirrors.hpp"
 
 std::vector<int> FragileMirrors::destroy(const std::vector<std::string> & board) {
-    BeamSearchNew<Board_v6> solver;
-    solver.set_millis(8000);
-    solver.set_beam_width(100);
-    auto w = solver.Destroy(board);
-    return ToSolution(w.CastHistory());
+    // sizes of BoardFixedSizes get their own instantiation, others go with Board_v6
+    return WithBoard_v6_Fixed(board, [](const auto& b) {
+        BeamSearchNew<decay_t<decltype(b)>> solver;
+        solver.set_millis(8000);
+        solver.set_beam_width(100);
+        auto w = solver.Destroy(b);
+        return ToSolution(w.CastHistory());
+    });
 }
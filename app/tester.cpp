@@ -1,7 +1,9 @@
 /// this project is used to test new methods on real data
-/// 
+/// -trace : file for layer trace of the solve, build with FRAGMIR_TRACE
 
 
+#include "ant/core/core.hpp"
+
 #include "util.hpp"
 #include "score.hpp"
 #include "board_v1_impl_1.hpp"
@@ -39,6 +41,12 @@ int main(int argc, const char * argv[]) {
     solver.set_beam_width(initWidth);
     //solver.set_score(s);
     auto w = solver.Destroy(board);
+    command_line_parser parser(argv, argc);
+    if (parser.exists("trace")) {
+        ofstream trace(parser.getValue("trace"));
+        SolveTrace::PrintHeader(trace);
+        solver.trace().Print(trace, "0");
+    }
     //LevelScoreDiff(solver, b, w);
     PrintSolution(out, w.CastHistory());
     //PrintSolution(std::cout, w.CastHistory());
@@ -0,0 +1,43 @@
+//
+// Created by Anton Logunov on 5/24/17.
+//
+// own translation unit, so that replaced new and delete are never inlined
+// next to each other and compiler doesn't take free for mismatched
+#include <atomic>
+#include <new>
+#include <cstdlib>
+
+using namespace std;
+
+
+// every allocation of the benchmark binary is counted here
+atomic<size_t> AllocatedBytes{0};
+
+void* operator new(size_t size) {
+    AllocatedBytes.fetch_add(size, memory_order_relaxed);
+    if (auto p = malloc(size)) return p;
+    throw bad_alloc();
+}
+
+void* operator new(size_t size, align_val_t align) {
+    AllocatedBytes.fetch_add(size, memory_order_relaxed);
+    auto a = static_cast<size_t>(align);
+    if (auto p = aligned_alloc(a, (size + a - 1) / a * a)) return p;
+    throw bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, align_val_t) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t, align_val_t) noexcept {
+    free(p);
+}
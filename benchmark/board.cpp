@@ -7,11 +7,19 @@
 #include "board_v2_impl_1.hpp"
 #include "board_v5.hpp"
 #include "board_v6.hpp"
+#include "board_v7.hpp"
+#include "board_v8.hpp"
+#include "board_v9.hpp"
+#include "hash_set.hpp"
+#include "top_k.hpp"
 
 
 using B_1 = Board_v2_Impl_1<CastHistory_Nodes>;
 using B_2 = Board_v5;
 using B_3 = Board_v6;
+using B_4 = Board_v7;
+using B_5 = Board_v8;
+using B_6 = Board_v9;
 
 
 template <class B>
@@ -28,13 +36,23 @@ static void BeamSearchBenchmark(benchmark::State& state) {
 BENCHMARK_TEMPLATE(BeamSearchBenchmark, B_1)->Arg(50)->Arg(100);
 BENCHMARK_TEMPLATE(BeamSearchBenchmark, B_2)->Arg(50)->Arg(100);
 BENCHMARK_TEMPLATE(BeamSearchBenchmark, B_3)->Arg(50)->Arg(100);
+BENCHMARK_TEMPLATE(BeamSearchBenchmark, B_4)->Arg(50)->Arg(100);
+BENCHMARK_TEMPLATE(BeamSearchBenchmark, B_5)->Arg(50)->Arg(100);
+BENCHMARK_TEMPLATE(BeamSearchBenchmark, B_6)->Arg(50)->Arg(100);
 
 
+// random casts until the board is clear, every iteration starts from the same board.
+// for cache misses run it under: perf stat -e cache-misses,L1-dcache-load-misses
 template <class B>
 static void BoardCastBenchmark(benchmark::State& state) {
     RNG.seed(0);
-    B b = GenerateStringBoard(state.range(0));
+    const B b_0 = GenerateStringBoard(state.range(0));
+    B b;
     while (state.KeepRunning()) {
+        state.PauseTiming();
+        b = b_0;
+        RNG.seed(0);
+        state.ResumeTiming();
         while (!b.AllDestroyed()) {
             uniform_int_distribution<> ray_distr(0, b.RayCount()-1);
             b.Cast(ray_distr(RNG));
@@ -42,20 +60,24 @@ static void BoardCastBenchmark(benchmark::State& state) {
     }
 }
 
-BENCHMARK_TEMPLATE(BoardCastBenchmark, B_1)->Arg(50)->Arg(100);
-BENCHMARK_TEMPLATE(BoardCastBenchmark, B_2)->Arg(50)->Arg(100);
-BENCHMARK_TEMPLATE(BoardCastBenchmark, B_3)->Arg(50)->Arg(100);
+BENCHMARK_TEMPLATE(BoardCastBenchmark, B_1)->Arg(50)->Arg(75)->Arg(100);
+BENCHMARK_TEMPLATE(BoardCastBenchmark, B_2)->Arg(50)->Arg(75)->Arg(100);
+BENCHMARK_TEMPLATE(BoardCastBenchmark, B_3)->Arg(50)->Arg(75)->Arg(100);
+BENCHMARK_TEMPLATE(BoardCastBenchmark, B_4)->Arg(50)->Arg(75)->Arg(100);
+BENCHMARK_TEMPLATE(BoardCastBenchmark, B_5)->Arg(50)->Arg(75)->Arg(100);
+BENCHMARK_TEMPLATE(BoardCastBenchmark, B_6)->Arg(50)->Arg(75)->Arg(100);
 
 
 struct P {
     int sz;
-    double reduce_ratio;
+    double reduce_cost;
 };
 
+// last cost means never compact
 vector<P> ReduceBenchmarkArgs() {
     vector<P> args;
     for (auto i : {50, 75, 100}) {
-        for (auto r : {0.5, 0.63, 0.75, 1.}) {
+        for (auto r : {0., 1., 4., 16., 1e9}) {
             args.push_back({i, r});
         }
     }
@@ -72,7 +94,7 @@ static void ReduceBenchmark(benchmark::State& state) {
         auto p = args[state.range(0)];
         for (auto i = 0; i < 4; ++i) {
             Board_v6 b = GenerateStringBoard(p.sz);
-            b.set_reduce_empty_ratio(p.reduce_ratio);
+            b.set_reduce_cost(p.reduce_cost);
                 bs.Destroy(b);
             }
     }
@@ -81,3 +103,101 @@ static void ReduceBenchmark(benchmark::State& state) {
 BENCHMARK(ReduceBenchmark)->DenseRange(0, ReduceBenchmarkArgs().size()-1);
 
 
+// one beam layer worth of children hashes, every third is a duplicate
+vector<Board::HashType> LayerHashes(Count count) {
+    RNG.seed(0);
+    uniform_int_distribution<uint64_t> distr;
+    vector<Board::HashType> hs(count);
+    for (auto i = 0; i < count; ++i) {
+        hs[i] = (i % 3 == 2) ? hs[distr(RNG) % i] : Board::HashType(distr(RNG));
+    }
+    return hs;
+}
+
+struct UnorderedSetInsert {
+    bool operator()(unordered_set<Board::HashType>& s, const Board::HashType& h) {
+        return s.count(h) == 0 && s.insert(h).second;
+    }
+};
+
+struct LayerHashSetInsert {
+    bool operator()(LayerHashSet& s, const Board::HashType& h) {
+        return s.insert(h);
+    }
+};
+
+template <class Set, class Insert>
+static void HashSetBenchmark(benchmark::State& state) {
+    auto hs = LayerHashes(state.range(0));
+    Set visited;
+    Insert insert;
+    Count inserted = 0;
+    while (state.KeepRunning()) {
+        for (auto& h : hs) {
+            inserted += insert(visited, h);
+        }
+        visited.clear();
+    }
+    benchmark::DoNotOptimize(inserted);
+    state.SetItemsProcessed(state.iterations() * hs.size());
+}
+
+BENCHMARK_TEMPLATE(HashSetBenchmark, unordered_set<Board::HashType>, UnorderedSetInsert)->Range(1 << 12, 1 << 20);
+BENCHMARK_TEMPLATE(HashSetBenchmark, LayerHashSet, LayerHashSetInsert)->Range(1 << 12, 1 << 20);
+
+
+// same size as derivative of beam search
+struct SelectItem {
+    void* origin;
+    Position cast;
+    Board::HashType hash;
+    double score;
+    uint64_t padding;
+
+    bool operator<(const SelectItem& d) const {
+        return score > d.score;
+    }
+};
+
+// children of a layer with width 1000 on board 50, scores are close to each other
+vector<SelectItem> LayerChildren() {
+    RNG.seed(0);
+    uniform_int_distribution<> distr(0, 5000);
+    vector<SelectItem> items(200000);
+    for (auto& d : items) {
+        d.score = 1000. + distr(RNG) / 100.;
+    }
+    return items;
+}
+
+struct NthElementSelect {
+    void operator()(vector<SelectItem>& items, Count k) {
+        nth_element(items.begin(), items.begin()+k-1, items.end());
+        items.resize(k);
+    }
+};
+
+struct TopKSelect {
+    void operator()(vector<SelectItem>& items, Count k) {
+        top_k.Select(items, k, [](const SelectItem& d) { return d.score; });
+    }
+    TopK<SelectItem> top_k;
+};
+
+template <class Select>
+static void SelectBenchmark(benchmark::State& state) {
+    const auto items_0 = LayerChildren();
+    vector<SelectItem> items;
+    Select select;
+    while (state.KeepRunning()) {
+        state.PauseTiming();
+        items = items_0;
+        state.ResumeTiming();
+        select(items, state.range(0));
+    }
+    benchmark::DoNotOptimize(items.data());
+    state.SetItemsProcessed(state.iterations() * items_0.size());
+}
+
+BENCHMARK_TEMPLATE(SelectBenchmark, NthElementSelect)->Arg(100)->Arg(500)->Arg(1000)->Arg(5000);
+BENCHMARK_TEMPLATE(SelectBenchmark, TopKSelect)->Arg(100)->Arg(500)->Arg(1000)->Arg(5000);
@@ -0,0 +1,182 @@
+//
+// Created by Anton Logunov on 5/24/17.
+//
+// every engine end to end at fixed width or node budget on fixed seed boards,
+// so time doesn't decide how much work is done.
+// counters: casts of the found solution, nodes per second, bytes allocated per solve.
+// node is what the engine pays for: scored child for beam searches and greedy,
+// promoted derivative for BeamSearchNew, expanded board for DFS, playout for monte carlo
+#include <atomic>
+
+#include "benchmark/benchmark_api.h"
+
+#include "beam_search.hpp"
+#include "beam_search_history.hpp"
+#include "bs_balanced.hpp"
+#include "bs_new.hpp"
+#include "beam_search_replay.hpp"
+#include "greedy.hpp"
+#include "dfs.hpp"
+#include "nested_monte_carlo_search.hpp"
+#include "board_v1_impl_1.hpp"
+#include "board_v6.hpp"
+
+
+// counted by replaced operator new, see allocated_bytes.cpp
+extern atomic<size_t> AllocatedBytes;
+
+
+namespace {
+
+using B_1 = Board_v1_Impl_1<CastHistory_Nodes>;
+using B_6 = Board_v6;
+
+StrBoard FixedBoard(Count size) {
+    default_random_engine rng(size);
+    return GenerateStringBoard(size, rng);
+}
+
+// engines call score once per child they look at
+struct CountingScore {
+    using CountersOnly = true_type;
+
+    template<class B>
+    double operator()(const B& b) const {
+        ++*nodes;
+        return Score_v1()(b);
+    }
+
+    Count* nodes;
+};
+
+// solve returns cast count of the solution and adds to nodes
+template<class Solve>
+void RunEngine(benchmark::State& state, Solve solve) {
+    Count casts = 0;
+    Count nodes = 0;
+    size_t bytes = 0;
+    while (state.KeepRunning()) {
+        auto bytes_was = AllocatedBytes.load();
+        casts += solve(nodes);
+        bytes += AllocatedBytes.load() - bytes_was;
+    }
+    state.counters["casts"] = benchmark::Counter(casts, benchmark::Counter::kAvgIterations);
+    state.counters["nodes"] = benchmark::Counter(nodes, benchmark::Counter::kIsRate);
+    state.counters["bytes"] = benchmark::Counter(bytes, benchmark::Counter::kAvgIterations, benchmark::Counter::kIs1024);
+}
+
+const Count kBeamWidth = 200;
+// balancer widens the beam as search goes on
+const Count kBalancedBeamWidth = 20;
+// slow board, so narrower
+const Count kHistoryBeamWidth = 50;
+const Count kNewBeamWidth = 100;
+const Count kNewNodeBudget = 20000;
+// default 64 MB table would be cleared every solve and dominate the timing
+const size_t kNewDiscoveryMemory = 4 << 20;
+const Count kDFSNodeBudget = 5000;
+
+}
+
+
+static void BeamSearchEngine(benchmark::State& state) {
+    B_6 b = FixedBoard(state.range(0));
+    RunEngine(state, [&](Count& nodes) {
+        BeamSearch<B_6, CountingScore> s;
+        s.set_score({&nodes});
+        s.set_beam_width(kBeamWidth);
+        // width decides the work, not the timer
+        s.set_time(std::chrono::hours(1));
+        return s.Destroy(b).CastCount();
+    });
+}
+
+static void BeamSearchBalancedEngine(benchmark::State& state) {
+    B_6 b = FixedBoard(state.range(0));
+    RunEngine(state, [&](Count& nodes) {
+        BeamSearchBalanced<B_6, CountingScore> s;
+        s.set_score({&nodes});
+        s.set_beam_width(kBalancedBeamWidth);
+        s.set_time(std::chrono::hours(1));
+        return s.Destroy(b).CastCount();
+    });
+}
+
+static void BeamSearchNewEngine(benchmark::State& state) {
+    B_6 b = FixedBoard(state.range(0));
+    // solver and its discovery table are made once, Destroy only clears the table
+    BeamSearchNew<B_6> s;
+    s.set_beam_width(kNewBeamWidth);
+    s.set_node_budget(kNewNodeBudget);
+    s.set_discovery_memory(kNewDiscoveryMemory);
+    s.set_millis(3600*1000);
+    RunEngine(state, [&](Count& nodes) {
+        auto casts = s.Destroy(b).CastCount();
+        nodes += s.nodes();
+        return casts;
+    });
+}
+
+static void BeamSearchReplayEngine(benchmark::State& state) {
+    B_6 b = FixedBoard(state.range(0));
+    RunEngine(state, [&](Count& nodes) {
+        BeamSearchReplay<B_6, CountingScore> s;
+        s.set_score({&nodes});
+        s.set_beam_width(kBeamWidth);
+        s.set_time(std::chrono::hours(1));
+        return s.Destroy(b).CastCount();
+    });
+}
+
+static void BeamSearchHistoryEngine(benchmark::State& state) {
+    B_1 b = FixedBoard(state.range(0));
+    RunEngine(state, [&](Count& nodes) {
+        BeamSearchHistory<B_1, CountingScore> s;
+        s.set_score({&nodes});
+        s.set_beam_width(kHistoryBeamWidth);
+        return s.Destroy(b).CastCount();
+    });
+}
+
+static void GreedyEngine(benchmark::State& state) {
+    B_6 b = FixedBoard(state.range(0));
+    RunEngine(state, [&](Count& nodes) {
+        CountingScore score{&nodes};
+        // greedy takes the smallest
+        return Greedy<B_6>().Destroy(b, [&](const B_6& b) { return -score(b); }).CastCount();
+    });
+}
+
+static void DFSEngine(benchmark::State& state) {
+    B_1 b = FixedBoard(state.range(0));
+    RunEngine(state, [&](Count& nodes) {
+        DFS s;
+        s.set_node_budget(kDFSNodeBudget);
+        s.set_timeout(3600*1000);
+        auto casts = s.Destroy(b).CastCount();
+        nodes += s.nodes();
+        return casts;
+    });
+}
+
+static void NestedMonteCarloEngine(benchmark::State& state) {
+    B_1 b = FixedBoard(state.range(0));
+    RunEngine(state, [&](Count& nodes) {
+        // playouts are random
+        RNG.seed(0);
+        NestedMonteCarloSearch s;
+        auto casts = s.Destroy(BoardAdapter<B_1>(b))->CastCount();
+        nodes += s.playouts();
+        return casts;
+    });
+}
+
+BENCHMARK(BeamSearchEngine)->Arg(50)->Arg(75)->Arg(100)->Unit(benchmark::kMillisecond);
+BENCHMARK(BeamSearchBalancedEngine)->Arg(50)->Arg(75)->Arg(100)->Unit(benchmark::kMillisecond);
+BENCHMARK(BeamSearchNewEngine)->Arg(50)->Arg(75)->Arg(100)->Unit(benchmark::kMillisecond);
+BENCHMARK(BeamSearchReplayEngine)->Arg(50)->Arg(75)->Arg(100)->Unit(benchmark::kMillisecond);
+BENCHMARK(BeamSearchHistoryEngine)->Arg(50)->Arg(75)->Arg(100)->Unit(benchmark::kMillisecond);
+BENCHMARK(GreedyEngine)->Arg(50)->Arg(75)->Arg(100)->Unit(benchmark::kMillisecond);
+BENCHMARK(DFSEngine)->Arg(50)->Arg(75)->Arg(100)->Unit(benchmark::kMillisecond);
+// level 2 search grows too fast with the board for bigger sizes
+BENCHMARK(NestedMonteCarloEngine)->Arg(50)->Unit(benchmark::kMillisecond);
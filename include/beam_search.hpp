@@ -7,29 +7,42 @@
 //
 #pragma once
 
+#include <experimental/optional>
+
 #include "util.hpp"
 #include "board.hpp"
 #include "score.hpp"
+#include "naive_search.hpp"
+#include "worker_pool.hpp"
+#include "hash_set.hpp"
+#include "board_pool.hpp"
+#include "time_balancer.hpp"
+#include "trace.hpp"
+#include "top_k.hpp"
 
 
 // has to keep ScoreType as template parameter to support
 // score functions that require specific board class as argument
 template<class BoardType, class ScoreType>
 class BeamSearch {
+    static_assert(IsStaticBoard<BoardType>::value, "board calls would be virtual");
 
     using HashType = typename BoardType::HashType;
     using CastType = typename BoardType::CastType;
-    
-    /// can make use of more parametered possibly 
+    // double or IntScore
+    using ScoreValue = decltype(declval<const ScoreType&>()(declval<const BoardType&>()));
+
+    /// can make use of more parametered possibly
     struct Derivative {
         Derivative() {}
-        Derivative(BoardType* b, const CastType& p, HashType h, double s)
-        : origin(b), cast(p), hash(h), score(s) {}
+        Derivative(BoardType* b, const CastType& p, HashType h, ScoreValue s)
+        : origin(b), hash(h), score(s), cast(p) {}
 
+        // int score and short cast fit into one word after hash
         BoardType* origin;
-        CastType cast;
         HashType hash;
-        double score;
+        ScoreValue score;
+        CastType cast;
         
         /// want to sort in reverse order
         bool operator<(const Derivative& d) const {
@@ -37,54 +50,134 @@ class BeamSearch {
         }
     };
 
+    static ScoreValue DerivativeScore(const Derivative& d) {
+        return d.score;
+    }
+
+    // everything a thread needs to expand its part of the layer
+    struct Worker {
+        // children split by hash, so that every duplicate ends up with the same worker
+        vector<vector<Derivative>> buckets;
+        LayerHashSet visited;
+        vector<Derivative> best;
+        TopK<Derivative> top_k;
+        BoardType scratch;
+        // only counted with FRAGMIR_TRACE
+        Count children;
+        Count dedup_hits;
+        Count reduce_calls;
+    };
+
 public:
 
     BoardType Destroy(const BoardType& b_in) {
-        unordered_set<HashType> visited;
+        LayerHashSet visited;
         vector<Derivative> derivs;
-        vector<BoardType> b_0;
-        vector<BoardType> b_1;
+        BoardPool<BoardType> b_0;
+        BoardPool<BoardType> b_1;
         b_0.reserve(beam_width_);
         b_1.reserve(beam_width_);
         Count side_count = 4;
         derivs.reserve(beam_width_*side_count*b_in.size());
         auto cur = &b_0;
         auto next = &b_1; 
-        cur->push_back(b_in);
+        // history of layers is collected, boards of the caller shouldn't see that
+        BoardType root = b_in;
+        root.DetachHistory();
+        cur->push_back(root);
+        if (pool_) InitWorkers(root);
+        Count width = beam_width_;
+        unique_ptr<TimeBalancer<BoardType>> balancer;
+        if (deadline_) {
+            balancer.reset(new TimeBalancer<BoardType>(*deadline_, deadline_ratio_));
+            width = balancer->FirstBeamWidth(root, width);
+        }
+        layer_count_ = 0;
+        layer_widths_.clear();
+        layer_hashes_.clear();
+        trace_.clear();
         Timer timer{std::chrono::duration_cast<std::chrono::milliseconds>(time_).count()};
-        while (!timer.timeout()) {
-            for (auto& b : *cur) {
-                Count d_was = b.MirrorsDestroyed();
-                auto func = [&](CastType c) {
-                    Count d_now = b.MirrorsDestroyed();
-                    if (d_now > d_was && visited.count(b.hash()) == 0) {
-                        visited.insert(b.hash());
-                        derivs.emplace_back(&b, c, b.hash(), score_(b));
-                    }
-                };
-                b.ForEachAppliedCast(func);
+        // with deadline balancer shrinks width to end in time, whatever is left
+        // at deadline ratio is finished greedily
+        while (balancer ? !balancer->Over() : !timer.timeout()) {
+            if (balancer) balancer->StartLayer(*cur);
+            TRACE(
+                auto layer_start = TraceClock::now();
+                auto reduce_calls_was = TraceReduceCalls;
+                auto& layer = trace_.NewLayer();
+                layer.width = width;
+                layer.boards = cur->size();
+            )
+            if (pool_) {
+                ExpandParallel(*cur, derivs, width);
+                TRACE(for (auto& w : workers_) {
+                    layer.children += w.children;
+                    layer.dedup_hits += w.dedup_hits;
+                    layer.reduce_calls += w.reduce_calls;
+                })
+            } else {
+                for (auto& b : *cur) {
+                    b.ReduceIfWorth();
+                    Count d_was = b.MirrorsDestroyed();
+                    auto func = [&](CastType c) {
+                        Count d_now = b.MirrorsDestroyed();
+                        if (d_now == d_was) return;
+                        bool fresh = visited.insert(b.hash());
+                        TRACE(++layer.children; layer.dedup_hits += !fresh;)
+                        if (fresh) {
+                            derivs.emplace_back(&b, c, b.hash(), score_(b));
+                        }
+                    };
+                    b.ForEachAppliedCast(func);
+                }
             }
-            Count sz = min<Count>(beam_width_, derivs.size());
-            nth_element(derivs.begin(), derivs.begin()+sz-1, derivs.end());
-            derivs.resize(sz);
+            TRACE(auto select_start = TraceClock::now();)
+            top_k_.Select(derivs, width, DerivativeScore);
+            // layer goes in trie order like in BeamSearchReplay: children by parent, then by cast.
+            // reduce keeps order of rays, so both expand children in the same order
+            sort(derivs.begin(), derivs.end(), [](const Derivative& d_0, const Derivative& d_1) {
+                return d_0.origin < d_1.origin || (d_0.origin == d_1.origin && d_0.cast < d_1.cast);
+            });
+            Count sz = derivs.size();
+            TRACE(layer.select_ms = MillisSince(select_start);)
+            TRACE(auto copy_start = TraceClock::now();)
             next->resize(sz);
-            for (Index i = 0; i < sz; ++i) {
-                (*next)[i] = *(derivs[i].origin);
-                (*next)[i].Cast(derivs[i].cast);
+            if (pool_) {
+                MaterializeParallel(derivs, *next);
+            } else {
+                for (Index i = 0; i < sz; ++i) {
+                    (*next)[i] = *(derivs[i].origin);
+                    (*next)[i].Cast(derivs[i].cast);
+                }
             }
+            TRACE(
+                layer.copy_ms = MillisSince(copy_start);
+                // with pool this thread is worker 0, its reduces are counted there
+                if (!pool_) layer.reduce_calls = TraceReduceCalls - reduce_calls_was;
+                layer.layer_ms = MillisSince(layer_start);
+            )
             swap(cur, next);
+            ++layer_count_;
+            layer_widths_.push_back(width);
+            if (record_layers_) {
+                layer_hashes_.emplace_back();
+                for (auto& b : *cur) layer_hashes_.back().push_back(b.hash());
+            }
             auto rr = max_element(cur->begin(), cur->end(), [] (const BoardType& b_0, const BoardType& b_1) {
                 return b_0.MirrorsDestroyed() < b_1.MirrorsDestroyed();
             });
             if (rr->AllDestroyed()) {
                 return *rr;   
             }
+            if (balancer) width = balancer->NextBeamWidth(*cur, width);
             /// cleanup before next step
+            BoardType::CollectHistory(*cur);
+            BoardType::ShareTopology(*cur);
             next->clear();
             derivs.clear();
             visited.clear();
         }
-        return b_in;
+        return Complete(*cur);
     }
 
     void set_score(ScoreType score) {
@@ -99,7 +192,149 @@ public:
         time_ = time;
     }
 
+    // layers expanded by last Destroy
+    Count layer_count() const {
+        return layer_count_;
+    }
+
+    // width every layer of last Destroy was selected with
+    const vector<Count>& layer_widths() const {
+        return layer_widths_;
+    }
+
+    // hashes of boards of every layer, in layer order
+    void set_record_layers(bool record_layers) {
+        record_layers_ = record_layers;
+    }
+
+    // empty unless layers are recorded
+    const vector<vector<HashType>>& layer_hashes() const {
+        return layer_hashes_;
+    }
+
+    // empty unless built with FRAGMIR_TRACE
+    const SolveTrace& trace() const {
+        return trace_;
+    }
+
+    // beam_width_ bounds width of the first layer, every layer gets width
+    // that should end search at deadline_ratio of deadline.
+    // solution is always complete, set_time is ignored
+    void set_deadline(std::chrono::milliseconds deadline, double deadline_ratio = 0.95) {
+        deadline_ = deadline;
+        deadline_ratio_ = deadline_ratio;
+    }
+
+    // with more than one thread layer expansion and casts of selected children
+    // are split between workers of the pool
+    void set_thread_count(Count thread_count) {
+        if (thread_count > 1) {
+            pool_ = make_shared<WorkerPool>(thread_count);
+        } else {
+            pool_.reset();
+        }
+    }
+
+private:
+
+    // on timeout best board of the layer is finished greedily
+    BoardType Complete(const BoardPool<BoardType>& bs) {
+        auto best = max_element(bs.begin(), bs.end(), [&](const BoardType& b_0, const BoardType& b_1) {
+            return score_(b_0) < score_(b_1);
+        });
+        // finish doesn't depend on the score of the search, Score_v1 grows every cast
+        Score_v1 finish;
+        return NaiveSearch<BoardType, Score_v1>().Destroy(*best, finish);
+    }
+
+    void InitWorkers(const BoardType& b_in) {
+        workers_.resize(pool_->worker_count());
+        for (auto& w : workers_) {
+            w.buckets.resize(workers_.size());
+            w.scratch = b_in;
+            w.scratch.DetachScratch();
+        }
+    }
+
+    // first pass: every worker expands its share of boards and splits children by hash.
+    // second pass: every worker dedups its bucket from all workers and keeps only best width.
+    // derivs gets union of those, the final selection is left to the caller
+    void ExpandParallel(BoardPool<BoardType>& cur, vector<Derivative>& derivs, Count width) {
+        auto worker_count = workers_.size();
+        pool_->Run([&](Index w) {
+            auto& worker = workers_[w];
+            for (auto& bucket : worker.buckets) bucket.clear();
+            TRACE(
+                worker.children = 0;
+                auto reduce_calls_was = TraceReduceCalls;
+            )
+            Index begin, end;
+            tie(begin, end) = WorkerShare(cur.size(), w, worker_count);
+            for (auto i = begin; i < end; ++i) {
+                auto& b = cur[i];
+                b.ShareScratch(worker.scratch);
+                b.ReduceIfWorth();
+                Count d_was = b.MirrorsDestroyed();
+                auto func = [&](CastType c) {
+                    if (b.MirrorsDestroyed() > d_was) {
+                        TRACE(++worker.children;)
+                        auto h = b.hash();
+                        worker.buckets[std::hash<HashType>()(h) % worker_count].emplace_back(&b, c, h, score_(b));
+                    }
+                };
+                b.ForEachAppliedCast(func);
+            }
+            TRACE(worker.reduce_calls = TraceReduceCalls - reduce_calls_was;)
+        });
+        pool_->Run([&](Index w) {
+            auto& worker = workers_[w];
+            worker.visited.clear();
+            worker.best.clear();
+            TRACE(worker.dedup_hits = 0;)
+            for (auto& other : workers_) {
+                for (auto& d : other.buckets[w]) {
+                    bool fresh = worker.visited.insert(d.hash);
+                    TRACE(worker.dedup_hits += !fresh;)
+                    if (fresh) {
+                        worker.best.push_back(d);
+                    }
+                }
+            }
+            worker.top_k.Select(worker.best, width, DerivativeScore);
+        });
+        for (auto& w : workers_) {
+            derivs.insert(derivs.end(), w.best.begin(), w.best.end());
+        }
+    }
+
+    void MaterializeParallel(const vector<Derivative>& derivs, BoardPool<BoardType>& next) {
+        pool_->Run([&](Index w) {
+            Index begin, end;
+            tie(begin, end) = WorkerShare(derivs.size(), w, workers_.size());
+            for (auto i = begin; i < end; ++i) {
+                next[i] = *(derivs[i].origin);
+                next[i].ShareScratch(workers_[w].scratch);
+                next[i].Cast(derivs[i].cast);
+            }
+        });
+    }
+
+public:
+
     Count beam_width_;
     ScoreType score_;
     std::chrono::seconds time_{30};
+    Count layer_count_{0};
+
+private:
+
+    vector<Count> layer_widths_;
+    bool record_layers_{false};
+    vector<vector<HashType>> layer_hashes_;
+    shared_ptr<WorkerPool> pool_;
+    experimental::optional<std::chrono::milliseconds> deadline_;
+    double deadline_ratio_;
+    vector<Worker> workers_;
+    TopK<Derivative> top_k_;
+    SolveTrace trace_;
 };
@@ -4,10 +4,14 @@
 #pragma once
 
 #include "util.hpp"
+#include "board.hpp"
+#include "hash_set.hpp"
+#include "top_k.hpp"
 
 
 template<class Board, class Score>
 class BeamSearchHistory {
+    static_assert(IsStaticBoard<Board>::value, "board calls would be virtual");
 
     using HashType = typename Board::HashType;
     using CastType = typename Board::CastType;
@@ -34,8 +38,9 @@ class BeamSearchHistory {
 public:
 
     Board Destroy(const Board& b_in) {
-        unordered_set<HashType> visited;
+        LayerHashSet visited;
         vector<Derivative> derivs;
+        TopK<Derivative> top_k;
         Count side_count = 4;
         derivs.reserve(beam_width_*side_count*b_in.size());
         MakeNewBeamLevel();
@@ -47,16 +52,14 @@ public:
                 for (auto& c : b.CastCandidates()) {
                     b.Cast(c);
                     Count d_now = b.MirrorsDestroyed();
-                    if (d_now > d_was && visited.count(b.hash()) == 0) {
-                        visited.insert(b.hash());
+                    if (d_now > d_was && visited.insert(b.hash())) {
                         derivs.emplace_back(&b, c, b.hash(), score_(b));
                     }
                     b.Restore();
                 }
             }
-            Count sz = min<Count>(beam_width_, derivs.size());
-            nth_element(derivs.begin(), derivs.begin()+sz-1, derivs.end());
-            derivs.resize(sz);
+            top_k.Select(derivs, beam_width_, [](const Derivative& d) { return d.score; });
+            Count sz = derivs.size();
             cur_beam_level().resize(sz);
             for (Index i = 0; i < sz; ++i) {
                 derivs[i].origin->Cast(derivs[i].cast);
@@ -0,0 +1,206 @@
+//
+// Created by Anton Logunov on 5/28/17.
+//
+#pragma once
+
+#include "util.hpp"
+#include "board.hpp"
+#include "score.hpp"
+#include "naive_search.hpp"
+#include "hash_set.hpp"
+#include "top_k.hpp"
+
+
+// beam search that keeps one working board instead of a board per beam slot.
+// survivors of every layer are nodes of history trie: parent on the layer
+// before and the cast. layer is kept in trie order, so neighbours share
+// long prefix, and working board moves from one to the next by undoing
+// casts down to common parent and casting the rest of the path.
+// slot costs one node, beam can be much wider than with copied boards.
+// working board keeps ray cache when score reads only counters:
+// slots of one parent see the same rays.
+// board has to provide CastLogged, UndoLogged and EnableRayCache, like Board_v6
+template<class BoardType, class ScoreType>
+class BeamSearchReplay {
+    static_assert(IsStaticBoard<BoardType>::value, "board calls would be virtual");
+
+    using CastType = typename BoardType::CastType;
+    using HashType = typename BoardType::HashType;
+    using ScoreValue = decltype(declval<const ScoreType&>()(declval<const BoardType&>()));
+
+    struct Node {
+        // index on previous layer
+        Index parent;
+        CastType cast;
+    };
+
+    struct Derivative {
+        Derivative() {}
+        Derivative(Index parent, CastType cast, ScoreValue score, bool finished)
+        : parent(parent), score(score), cast(cast), finished(finished) {}
+
+        Index parent;
+        ScoreValue score;
+        CastType cast;
+        bool finished;
+    };
+
+    static ScoreValue DerivativeScore(const Derivative& d) {
+        return d.score;
+    }
+
+public:
+
+    BoardType Destroy(const BoardType& b_in) {
+        work_ = b_in;
+        work_.DetachScratch();
+        // cached children keep links of the parent
+        if (IsCountersOnlyScore<ScoreType>::value) work_.EnableRayCache();
+        layers_.assign(1, {Node{0, -1}});
+        work_nodes_.assign(1, 0);
+        log_.clear();
+        frames_.clear();
+        replay_casts_ = 0;
+
+        LayerHashSet visited;
+        vector<Derivative> derivs;
+        TopK<Derivative> top_k;
+        Timer timer{std::chrono::duration_cast<std::chrono::milliseconds>(time_).count()};
+        while (!timer.timeout()) {
+            Index layer = layers_.size()-1;
+            auto& nodes = layers_.back();
+            for (Index i = 0; i < nodes.size(); ++i) {
+                MoveTo(layer, i);
+                Count d_was = work_.MirrorsDestroyed();
+                work_.ForEachAppliedCast([&](CastType c) {
+                    if (work_.MirrorsDestroyed() == d_was) return;
+                    if (visited.insert(work_.hash())) {
+                        derivs.emplace_back(i, c, score_(work_), work_.AllDestroyed());
+                    }
+                });
+            }
+            if (derivs.empty()) break;
+            top_k.Select(derivs, beam_width_, DerivativeScore);
+            // trie order: parents are in it already, children of one parent by cast
+            sort(derivs.begin(), derivs.end(), [](const Derivative& d_0, const Derivative& d_1) {
+                return d_0.parent < d_1.parent || (d_0.parent == d_1.parent && d_0.cast < d_1.cast);
+            });
+            layers_.emplace_back();
+            auto& next = layers_.back();
+            next.reserve(derivs.size());
+            // layer is complete even if it's the last one
+            Index finished = -1;
+            for (auto& d : derivs) {
+                if (d.finished && finished < 0) finished = next.size();
+                next.push_back({d.parent, d.cast});
+            }
+            if (finished >= 0) return Materialize(b_in, layers_.size()-1, finished);
+            derivs.clear();
+            visited.clear();
+        }
+        return Complete(b_in);
+    }
+
+    void set_score(ScoreType score) {
+        score_ = score;
+    }
+
+    void set_beam_width(Count beam_width) {
+        beam_width_ = beam_width;
+    }
+
+    void set_time(std::chrono::seconds time) {
+        time_ = time;
+    }
+
+    // layers expanded by last Destroy
+    Count layer_count() const {
+        return layers_.size()-1;
+    }
+
+    // casts done and undone on working board by last Destroy to move between slots
+    Count replay_casts() const {
+        return replay_casts_;
+    }
+
+    // hashes of boards of the layer of last Destroy, in layer order.
+    // every slot is replayed, that's for checks, not for the search
+    vector<HashType> LayerHashes(Index layer) {
+        vector<HashType> res;
+        for (Index i = 0; i < layers_[layer].size(); ++i) {
+            MoveTo(layer, i);
+            res.push_back(work_.hash());
+        }
+        return res;
+    }
+
+private:
+
+    // working board goes to node i of layer
+    void MoveTo(Index layer, Index i) {
+        // nodes of target path above common parent, deepest first
+        path_.clear();
+        auto depth = layer;
+        while (depth >= work_nodes_.size() || work_nodes_[depth] != i) {
+            path_.push_back(i);
+            i = layers_[depth][i].parent;
+            --depth;
+        }
+        while (work_nodes_.size() > depth+1) {
+            work_.UndoLogged(log_, log_.size() - frames_.back());
+            frames_.pop_back();
+            work_nodes_.pop_back();
+            ++replay_casts_;
+        }
+        for (auto it = path_.rbegin(); it != path_.rend(); ++it) {
+            frames_.push_back(log_.size());
+            work_.CastLogged(layers_[++depth][*it].cast, log_);
+            work_nodes_.push_back(*it);
+            ++replay_casts_;
+        }
+    }
+
+    // board of the caller with casts of the node path, history included
+    BoardType Materialize(const BoardType& b_in, Index layer, Index i) const {
+        vector<CastType> casts;
+        for (; layer > 0; --layer) {
+            casts.push_back(layers_[layer][i].cast);
+            i = layers_[layer][i].parent;
+        }
+        BoardType b = b_in;
+        for (auto it = casts.rbegin(); it != casts.rend(); ++it) b.Cast(*it);
+        return b;
+    }
+
+    // on timeout best node of the last layer is finished greedily
+    BoardType Complete(const BoardType& b_in) {
+        Index layer = layers_.size()-1;
+        Index best = 0;
+        ScoreValue best_score{};
+        for (Index i = 0; i < layers_[layer].size(); ++i) {
+            MoveTo(layer, i);
+            auto s = score_(work_);
+            if (i == 0 || s > best_score) {
+                best = i;
+                best_score = s;
+            }
+        }
+        // same finish as BeamSearch, Score_v1 grows every cast
+        Score_v1 finish;
+        return NaiveSearch<BoardType, Score_v1>().Destroy(Materialize(b_in, layer, best), finish);
+    }
+
+    Count beam_width_;
+    ScoreType score_;
+    std::chrono::seconds time_{30};
+
+    vector<vector<Node>> layers_;
+    BoardType work_;
+    // node of every layer on the path of working board
+    vector<Index> work_nodes_;
+    // destroyed items of every cast on the path, frames are where casts start
+    vector<short> log_;
+    vector<Index> frames_;
+    vector<Index> path_;
+    Count replay_casts_;
+};
@@ -11,6 +11,7 @@
 #include <ant/core/core.hpp>
 
 #include "util.hpp"
+#include "trace.hpp"
 
 
 class Board {
@@ -59,10 +60,17 @@ public:
         }
     }
 
+    // nothing to compact
+    bool ReduceIfWorth() {
+        return false;
+    }
+
     virtual ~Board_v1() {}
 };
 
 
+// Restore takes back last CastRestorable. boards with NestedRestore
+// keep a stack of them, others only the last one
 class Board_v2 : public Board {
 public:
     using CastType = short ;
@@ -84,29 +92,239 @@ public:
     virtual ~Board_v2() {}
 };
 
-class Board_v2_Reduce : public Board_v2 {
+// static side of the board interface, Derived is the final board class.
+// engines are templated on board type, everything they call on the board
+// goes to Derived and is resolved at compile time, so it can be inlined.
+// Interface is virtual class that BoardAdapter implements for the board,
+// for code that only holds Board&. boards themselves have no virtual calls
+template<class Derived, class Interface_>
+class BoardStatic {
+public:
+    using Interface = Interface_;
+    using HashType = Board::HashType;
+
+    Count MirrorsLeft() const {
+        auto& b = derived();
+        return (Count)(b.size() * b.size() - b.MirrorsDestroyed());
+    }
+
+    bool AllDestroyed() const {
+        return derived().MirrorsLeft() == 0;
+    }
+
+protected:
+    Derived& derived() {
+        static_assert(is_final<Derived>::value, "board should be final, engines bind to it");
+        return static_cast<Derived&>(*this);
+    }
+
+    const Derived& derived() const {
+        static_assert(is_final<Derived>::value, "board should be final, engines bind to it");
+        return static_cast<const Derived&>(*this);
+    }
+};
+
+
+template<class Derived>
+class Board_v1_Static : public BoardStatic<Derived, Board_v1> {
+public:
+    using CastType = Position;
+
+    template<class Functor>
+    void ForEachAppliedCast(Functor func) {
+        auto& b = this->derived();
+        for (auto& p : b.CastCandidates()) {
+            b.Cast(p);
+            func(p);
+            b.Restore();
+        }
+    }
+
+    // nothing to compact
+    bool ReduceIfWorth() {
+        return false;
+    }
+};
+
+
+// compaction is a pass over all items. without it every copy of the board carries
+// dead items and every expansion casts rays of empty lines. so a board compacts only
+// when that waste over the casts it has left outweighs one pass.
+// searches ask right before expanding a board: children that are thrown away
+// in selection never pay for compaction, boards close to the end rarely do.
+// Derived provides CastImpl, Reduce, EmptySpace and TotalSpace
+template<class Derived>
+class Board_v2_Reduce_Static : public BoardStatic<Derived, Board_v2> {
 public:
+    using CastType = short;
+
+    Count Cast(short ray_index) {
+        return this->derived().CastImpl(ray_index);
+    }
 
-    Count Cast(short ray_index) final {
-        auto destroyed = CastImpl(ray_index);
-        if (EmptySpace()/TotalSpace() > reduce_empty_ratio_) {
-            Reduce();
+    // same as in Board_v2, also measures rays that destroy nothing
+    template<class Functor>
+    void ForEachAppliedCast(Functor func) {
+        auto& b = this->derived();
+        Count empty_rays = 0;
+        for (auto i = 0; i < b.RayCount(); ++i) {
+            empty_rays += b.CastRestorable(i) == 0;
+            func(i);
+            b.Restore();
         }
-        return destroyed;
+        this->empty_rays_ = empty_rays;
     }
 
-    void set_reduce_empty_ratio(double ratio) {
-        reduce_empty_ratio_ = ratio;
+    // ray indices change, nobody should keep them for this board
+    bool ReduceIfWorth() {
+        auto& b = this->derived();
+        if (b.EmptySpace() == 0 && this->empty_rays_ == 0) return false;
+        double cast_waste = b.EmptySpace() + this->kEmptyRayCost * this->empty_rays_;
+        if (cast_waste * CastsLeft() <= this->reduce_cost_ * b.TotalSpace()) return false;
+        TRACE(++TraceReduceCalls;)
+        b.Reduce();
+        this->empty_rays_ = 0;
+        return true;
+    }
+
+    // boards that share state between copies can move a layer to common one
+    template<class Boards>
+    static void ShareTopology(Boards& bs) {}
+
+    // cost of compaction per item, in copies of one item
+    void set_reduce_cost(double cost) {
+        reduce_cost_ = cost;
     }
 
 protected:
-    virtual Count CastImpl(short ray_index) = 0;
-    virtual void Reduce() = 0;
+    // empty ray is cast, restored and checked by search, in copies of one item
+    constexpr static double kEmptyRayCost = 8;
 
-    virtual Count EmptySpace() const = 0;
-    virtual Count TotalSpace() const = 0;
+    // beam search time is flat between 0.5 and 2 on boards 75 and 100
+    double reduce_cost_{1};
+    // measured by last expansion, copies inherit it
+    Count empty_rays_{0};
 
 private:
-    // best parameter found out from benchmarking
-    double reduce_empty_ratio_{0.63};
+    // estimated from destroyed per cast so far
+    double CastsLeft() const {
+        auto& b = this->derived();
+        auto cast_count = b.CastCount();
+        double per_cast = cast_count == 0 ? 1. : max(1., 1. * b.MirrorsDestroyed() / cast_count);
+        return b.MirrorsLeft() / per_cast;
+    }
+};
+
+
+template<class B, class = void>
+struct HasNestedRestore : false_type {};
+
+template<class B>
+struct HasNestedRestore<B, void_t<typename B::NestedRestore>> : B::NestedRestore {};
+
+// what engines require from board type
+template<class B, class = void>
+struct IsStaticBoard : false_type {};
+
+template<class B>
+struct IsStaticBoard<B, void_t<typename B::Interface>>
+    : integral_constant<bool, is_final<B>::value && is_base_of<BoardStatic<B, typename B::Interface>, B>::value> {};
+
+
+// virtual interface over a copy of static board, for code that holds Board&
+// like NestedMonteCarloSearch. engines don't need it
+template<class B, class Interface = typename B::Interface>
+class BoardAdapter;
+
+template<class B, class Interface>
+class BoardAdapterBase : public Interface {
+public:
+    BoardAdapterBase(const B& b) : board_(b) {}
+
+    Board::HashType hash() const override {
+        return board_.hash();
+    }
+
+    Count MirrorsLeft() const override {
+        return board_.MirrorsLeft();
+    }
+
+    Count MirrorsDestroyed() const override {
+        return board_.MirrorsDestroyed();
+    }
+
+    Count size() const override {
+        return board_.size();
+    }
+
+    Count EmptyLinesCount() const override {
+        return board_.EmptyLinesCount();
+    }
+
+    Count CastCount() const override {
+        return board_.CastCount();
+    }
+
+    vector<Position> CastHistory() const override {
+        return board_.CastHistory();
+    }
+
+    bool AllDestroyed() const override {
+        return board_.AllDestroyed();
+    }
+
+    unique_ptr<Board> Clone() const override {
+        return make_unique<BoardAdapter<B>>(static_cast<const BoardAdapter<B>&>(*this));
+    }
+
+    const B& board() const {
+        return board_;
+    }
+
+protected:
+    B board_;
+};
+
+template<class B>
+class BoardAdapter<B, Board_v1> final : public BoardAdapterBase<B, Board_v1> {
+public:
+    using BoardAdapterBase<B, Board_v1>::BoardAdapterBase;
+
+    bool IsLineEmpty(Position p) const override {
+        return this->board_.IsLineEmpty(p);
+    }
+
+    Count Cast(const Position& p) override {
+        return this->board_.Cast(p);
+    }
+
+    void Restore() override {
+        this->board_.Restore();
+    }
+
+    const vector<Position>& CastCandidates() const override {
+        return this->board_.CastCandidates();
+    }
+};
+
+template<class B>
+class BoardAdapter<B, Board_v2> final : public BoardAdapterBase<B, Board_v2> {
+public:
+    using BoardAdapterBase<B, Board_v2>::BoardAdapterBase;
+
+    Count Cast(short ray_index) override {
+        return this->board_.Cast(ray_index);
+    }
+
+    void Restore() override {
+        this->board_.Restore();
+    }
+
+    Count CastRestorable(short ray_index) override {
+        return this->board_.CastRestorable(ray_index);
+    }
+
+    Count RayCount() const override {
+        return this->board_.RayCount();
+    }
 };
@@ -4,38 +4,87 @@
 
 #pragma once
 
+#include <mutex>
+#include <map>
+
 #include "util.hpp"
 
+
+// zobrist keys of one board size, one per cell.
+// hash of "nothing" is folded into every key at init, so mirror going
+// in or out of the board is a single xor
+class ZobristTable {
+public:
+    explicit ZobristTable(Count size) : size_(size), keys_(size*size) {
+        // same keys for the size in every run
+        mt19937_64 rng(size);
+        auto nothing = rng();
+        for (auto& k : keys_) k = rng() ^ nothing;
+    }
+
+    // tables live till the end of the program, boards keep raw pointers
+    static const ZobristTable& ForSize(Count size) {
+        static mutex m;
+        static map<Count, unique_ptr<ZobristTable>> tables;
+        lock_guard<mutex> lock(m);
+        auto& t = tables[size];
+        if (!t) t.reset(new ZobristTable(size));
+        return *t;
+    }
+
+    const uint64_t* keys() const {
+        return keys_.data();
+    }
+
+    Count size() const {
+        return size_;
+    }
+
+private:
+    Count size_;
+    vector<uint64_t> keys_;
+};
+
+
 class BoardHash {
 
     constexpr static size_t HashBitsCount = 64;
-    using HashFunction = ZobristHashing<HashBitsCount>;
 public:
-    using HashType = typename HashFunction::value;
+    using HashType = bitset<HashBitsCount>;
 
 
     BoardHash() {}
 
     BoardHash(Count sz) {
-        hash_function_.reset(new HashFunction({sz, sz}, 1));
+        auto& table = ZobristTable::ForSize(sz);
+        keys_ = table.keys();
+        size_ = table.size();
     }
 
     void HashIn(char row, char col) {
         HashIn({row, col});
     }
 
+    // in and out are the same xor, key has nothing folded in
     void HashIn(const Position& p) {
-        hash_function_->xorNothing(&hash_); // xor out
-        hash_function_->xorState(&hash_, p, 0);
+        hash_ ^= keys_[p.row*size_ + p.col];
     }
 
     void HashOut(const Position& p) {
-        hash_function_->xorState(&hash_, p, 0); // xor out
-        hash_function_->xorNothing(&hash_); // xor in
+        hash_ ^= keys_[p.row*size_ + p.col];
+    }
+
+    HashType hash() const {
+        return HashType(hash_);
+    }
+
+    // difference of two hashes, xor of keys of the cells in between
+    uint64_t delta(const BoardHash& bh) const {
+        return hash_ ^ bh.hash_;
     }
 
-    const HashType& hash() const {
-        return hash_;
+    void Apply(uint64_t delta) {
+        hash_ ^= delta;
     }
 
     void clear() {
@@ -47,10 +96,11 @@ public:
     }
 
     bool operator==(const BoardHash& bh) const {
-        return bh.hash_ == hash_ && bh.hash_function_ == hash_function_;
+        return bh.hash_ == hash_ && bh.keys_ == keys_;
     }
 
 private:
-    shared_ptr<HashFunction> hash_function_;
-    HashType hash_;
-};
\ No newline at end of file
+    const uint64_t* keys_{nullptr};
+    Count size_{0};
+    uint64_t hash_{0};
+};
@@ -0,0 +1,72 @@
+//
+// Created by Anton Logunov on 5/6/17.
+//
+#pragma once
+
+#include "util.hpp"
+
+
+// boards of one beam layer.
+// slots are never destroyed between layers, so board vectors keep their capacity
+// and assigning a board to a used slot copies its state without allocations
+template<class Board>
+class BoardPool {
+public:
+    using iterator = typename vector<Board>::iterator;
+    using const_iterator = typename vector<Board>::const_iterator;
+
+    void reserve(Count count) {
+        slots_.reserve(count);
+    }
+
+    void resize(Count count) {
+        if (slots_.size() < count) slots_.resize(count);
+        count_ = count;
+    }
+
+    void push_back(const Board& b) {
+        resize(count_ + 1);
+        slots_[count_ - 1] = b;
+    }
+
+    // slots stay allocated
+    void clear() {
+        count_ = 0;
+    }
+
+    Count size() const {
+        return count_;
+    }
+
+    bool empty() const {
+        return count_ == 0;
+    }
+
+    Board& operator[](Index i) {
+        return slots_[i];
+    }
+
+    const Board& operator[](Index i) const {
+        return slots_[i];
+    }
+
+    iterator begin() {
+        return slots_.begin();
+    }
+
+    iterator end() {
+        return slots_.begin() + count_;
+    }
+
+    const_iterator begin() const {
+        return slots_.begin();
+    }
+
+    const_iterator end() const {
+        return slots_.begin() + count_;
+    }
+
+private:
+    vector<Board> slots_;
+    Count count_{0};
+};
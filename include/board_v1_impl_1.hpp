@@ -17,7 +17,7 @@ using namespace ant::grid;
 
 
 template<class CastHistoryType>
-class Board_v1_Impl_1 : public Board_v1 {
+class Board_v1_Impl_1 final : public Board_v1_Static<Board_v1_Impl_1<CastHistoryType>> {
 
     // supports -1, -1 origin now
     using Neighbors = OriginGrid<Grid<array<int8_t, 4>>>;
@@ -57,13 +57,13 @@ public:
         return b;
     }
 
-    Count CastCount() const override {
+    Count CastCount() const {
         return history_casts_.Count();
     }
 
     // return count of destroyed
     // to know if anything was destroyed at all
-    Count Cast(const Position& ppp) override {
+    Count Cast(const Position& ppp) {
         last_cast_.clear();
         history_casts_.Push(ppp);
         Position p = ppp;
@@ -82,11 +82,11 @@ public:
         return count;
     }
 
-    const vector<Position>& CastCandidates() const override {
+    const vector<Position>& CastCandidates() const {
         return *cast_candidates_;
     }
 
-    void Restore() override {
+    void Restore() {
         history_casts_.Pop();
         destroyed_count_ -= last_cast_.size();
         assert(destroyed_count_ >= 0);
@@ -100,25 +100,25 @@ public:
         return board_size_;
     }
 
-    Int size() const override {
+    Int size() const {
         return board_size_;
     }
 
-    HashType hash() const override {
+    HashType hash() const {
         return board_hash_.hash();
     }
 
-    bool AllDestroyed() const override {
+    bool AllDestroyed() const {
         assert(destroyed_count_ <= mirror_count());
         return destroyed_count_ == mirror_count();
     }
 
     // maybe think about something different
-    vector<Position> CastHistory() const override {
+    vector<Position> CastHistory() const {
         return ToVector(history_casts_);
     }
 
-    Count MirrorsDestroyed() const override {
+    Count MirrorsDestroyed() const {
         return destroyed_count_;
     }
 
@@ -126,7 +126,7 @@ public:
         return size()*size();
     }
 
-    Count EmptyLinesCount() const override {
+    Count EmptyLinesCount() const {
         Count count = 0;
         for (int i = 0; i < board_size_; ++i) {
             if (neighbors_(-1, i)[kDirDown] == board_size_) ++count;
@@ -135,7 +135,7 @@ public:
         return count;
     }
 
-    bool IsLineEmpty(Position p) const override {
+    bool IsLineEmpty(Position p) const {
         Direction dir = FromDirection(p);
         tie(p, dir) = NextFrom(p, dir);
         auto& mirs = *mirrors_;
@@ -174,9 +174,6 @@ public:
     }
 
 
-    unique_ptr<Board> Clone() const override {
-        return move(make_unique<Board_v1_Impl_1>(*this));
-    }
 
     ~Board_v1_Impl_1() {}
 
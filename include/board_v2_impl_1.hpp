@@ -16,7 +16,7 @@ using namespace std;
 // space optimization
 // ray indexes are used
 template <class CastHistoryType>
-class Board_v2_Impl_1 : public Board_v2_Reduce {
+class Board_v2_Impl_1 final : public Board_v2_Reduce_Static<Board_v2_Impl_1<CastHistoryType>> {
 private:
     
     using int8_t = short;
@@ -195,7 +195,7 @@ public:
     }
     
     
-    Count CastRestorable(short ray_index) override {
+    Count CastRestorable(short ray_index) {
         auto& last = *restorable_buffer_; 
         
         Ray ray{ray_index, ray_direction_[ray_index]};
@@ -215,7 +215,7 @@ public:
         return last.size();
     }
     
-    Count CastImpl(short ray_index) override {
+    Count CastImpl(short ray_index) {
         auto& ray_item = items_[ray_index];
         history_casts_.Push({ray_item.row, ray_item.col});
 
@@ -234,11 +234,11 @@ public:
         return count;
     }
 
-    Count CastCount() const override {
+    Count CastCount() const {
         return history_casts_.Count();
     }
 
-    void Restore() override {
+    void Restore() {
         auto& last = *restorable_buffer_; 
         
         mirrors_destroyed_ -= last.size();
@@ -311,7 +311,7 @@ public:
     }
     
     // 4 * Number of items
-    void Reduce() override {
+    void Reduce() {
         auto& offset = *reduce_buffer_;
         offset.resize(items_.size());
         for (auto i = 0; i < ray_direction_.size(); ++i) {
@@ -356,23 +356,23 @@ public:
         filled_space_ = items_.size() - ray_direction_.size();
     }
     
-    bool AllDestroyed() const override {
+    bool AllDestroyed() const {
         return empty_lines_count_ == 2 * board_size_;
     }
     
-    Count size() const override {
+    Count size() const {
         return board_size_;
     }
     
-    Count RayCount() const override {
+    Count RayCount() const {
         return ray_direction_.size();
     }
     
-    Count MirrorsDestroyed() const override {
+    Count MirrorsDestroyed() const {
         return mirrors_destroyed_;
     }
     
-    Count EmptyLinesCount() const override {
+    Count EmptyLinesCount() const {
         return empty_lines_count_;
     }
 
@@ -380,11 +380,11 @@ public:
         return even_mirrors_lines_;
     }
 
-    BoardHash::HashType hash() const override {
+    BoardHash::HashType hash() const {
         return board_hash_.hash();
     }
     
-    Count EmptySpace() const override {
+    Count EmptySpace() const {
         return empty_space_;
     }
     
@@ -392,18 +392,32 @@ public:
         return filled_space_;
     }
 
-    Count TotalSpace() const override {
+    Count TotalSpace() const {
         return items_.size();
     }
 
-    vector<Position> CastHistory() const override {
+    vector<Position> CastHistory() const {
         return ToVector(history_casts_);
     }
 
-    unique_ptr<Board> Clone() const override {
-        return move(make_unique<Board_v2_Impl_1>(*this));
+
+    // mirrors are stored inside items, only buffers are shared between copies
+    void ShareScratch(const Board_v2_Impl_1& b) {
+        if (restorable_buffer_ != b.restorable_buffer_) restorable_buffer_ = b.restorable_buffer_;
+        if (reduce_buffer_ != b.reduce_buffer_) reduce_buffer_ = b.reduce_buffer_;
     }
 
+    void DetachScratch() {
+        restorable_buffer_.reset(new vector<short>());
+        reduce_buffer_.reset(new vector<short>());
+    }
+
+    // history nodes are owned by ref counts
+    void DetachHistory() {}
+
+    template<class Boards>
+    static void CollectHistory(const Boards& bs) {}
+
 
 private:
 
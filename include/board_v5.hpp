@@ -17,13 +17,11 @@
 using namespace std;
 
 // more optimization involved
-class Board_v5 : public Board_v2_Reduce {
+class Board_v5 final : public Board_v2_Reduce_Static<Board_v5> {
 private:
     
     using int8_t = short;
     
-    constexpr static size_t HashBitsCount = 64;
-    
     const constexpr static int kDirTop      = 0;
     const constexpr static int kDirBottom   = 1;
     const constexpr static int kDirLeft     = 2;
@@ -42,10 +40,11 @@ private:
     using Mirror = char;
     using Neighbors = array<short, 4>;
     
-    using HashFunction = ZobristHashing<HashBitsCount>;
     using Mirrors = Grid<int8_t>;
 public:
-    using HashType = typename HashFunction::value;
+    using HashType = BoardHash::HashType;
+    // CastRestorable can be called again before Restore
+    using NestedRestore = true_type;
     
 private:
        
@@ -91,6 +90,8 @@ public:
     
     Board_v5(const vector<string>& str_board) : board_size_(str_board.size()),
                                                 hash_(board_size_) {
+        empty_lines_param_ = EmptyLinesParam(board_size_);
+        empty_lines_param_int_ = EmptyLinesParamInt(board_size_);
         mirrors_destroyed_ = 0;
         empty_lines_count_ = 0;
         
@@ -193,7 +194,6 @@ private:
     }
     
     void InitHash() {
-        hash_function_.reset(new HashFunction({board_size_, board_size_}, 1));
         for (auto r = 0; r < board_size_; ++r) {
             for (auto c = 0; c < board_size_; ++c) {
                 hash_.HashIn(r, c);
@@ -203,9 +203,11 @@ private:
 
 public:
     
-    Count CastRestorable(short ray_index) override {
-        auto& last = *buffer_; 
-        last.clear();
+    // buffer is a stack of restorable casts: destroyed items of the cast
+    // followed by their count. casts nest, Restore takes back the last one
+    Count CastRestorable(short ray_index) {
+        auto& last = *buffer_;
+        Index start = last.size();
         auto& mirs = *mirrors_; 
         
         Ray ray{ray_index, ray_direction_[ray_index]};
@@ -222,11 +224,13 @@ public:
             ray = NextFromMirror(ray, mirs(r, c));
             mirs(r, c) += kMirOffset;
         }    
-        mirrors_destroyed_ += last.size();
-        return last.size();
+        Count count = last.size() - start;
+        last.push_back(count);
+        mirrors_destroyed_ += count;
+        return count;
     }
     
-    Count CastImpl(short ray_index) override {
+    Count CastImpl(short ray_index) {
         auto& mirs = *mirrors_;
         history_casts_.Push({rows_[ray_index], cols_[ray_index]});
 
@@ -244,12 +248,14 @@ public:
         return count;
     }
     
-    void Restore() override {
-        auto& last = *buffer_; 
+    void Restore() {
+        auto& last = *buffer_;
         auto& mirs = *mirrors_;
-        
-        mirrors_destroyed_ -= last.size();
-        while (!last.empty()) {
+
+        Count count = last.back();
+        last.pop_back();
+        mirrors_destroyed_ -= count;
+        for (; count > 0; --count) {
             char r = rows_[last.back()];
             char c = cols_[last.back()];
             mirs(r, c) -= kMirOffset;
@@ -305,7 +311,7 @@ public:
     }
     
     // 4 * Number of items
-    void Reduce() override {
+    void Reduce() {
         auto& offset = *buffer_;
         offset.resize(neighbors_.size());
         auto cur = 0;
@@ -363,35 +369,44 @@ public:
         filled_space_ = neighbors_.size() - ray_direction_.size();
     }
     
-    bool AllDestroyed() const override {
+    bool AllDestroyed() const {
         return empty_lines_count_ == 2 * board_size_;
     }
     
-    Count size() const override {
+    Count size() const {
         return board_size_;
     }
     
-    Count RayCount() const override {
+    Count RayCount() const {
         return ray_direction_.size();
     }
     
-    Count MirrorsDestroyed() const override {
+    Count MirrorsDestroyed() const {
         return mirrors_destroyed_;
     }
     
-    Count EmptyLinesCount() const override {
+    Count EmptyLinesCount() const {
         return empty_lines_count_;
     }
+
+    // look Board_v6
+    double ScoreValue_v1() const {
+        return mirrors_destroyed_ + empty_lines_param_ * empty_lines_count_;
+    }
+
+    IntScore ScoreValue_v1_Int() const {
+        return mirrors_destroyed_ * kScoreOne + empty_lines_param_int_ * empty_lines_count_;
+    }
     
-    HashType hash() const override {
+    HashType hash() const {
         return hash_.hash();
     }
     
-    Count EmptySpace() const override {
+    Count EmptySpace() const {
         return empty_space_;
     }
 
-    Count TotalSpace() const override {
+    Count TotalSpace() const {
         return neighbors_.size();
     }
     
@@ -399,22 +414,32 @@ public:
         return filled_space_;
     }
     
-    vector<Position> CastHistory() const override {
+    vector<Position> CastHistory() const {
         return ToVector(history_casts_);
     }
 
-    Count MirrorsLeft() const override {
-        return Board::MirrorsLeft();
+    Count CastCount() const {
+        return history_casts_.Count();
     }
 
-    Count CastCount() const override {
-        return history_casts_.Count();
+
+    // look Board_v6
+    void ShareScratch(const Board_v5& b) {
+        if (mirrors_ != b.mirrors_) mirrors_ = b.mirrors_;
+        if (buffer_ != b.buffer_) buffer_ = b.buffer_;
     }
 
-    unique_ptr<Board> Clone() const override {
-        return make_unique<Board_v5>(*this);
+    void DetachScratch() {
+        mirrors_.reset(new Mirrors(*mirrors_));
+        buffer_.reset(new vector<short>());
     }
 
+    // history nodes are owned by ref counts
+    void DetachHistory() {}
+
+    template<class Boards>
+    static void CollectHistory(const Boards& bs) {}
+
 private: 
 
     Ray NextFromMirror(const Ray& ray, char mir) const {
@@ -434,6 +459,8 @@ private:
 
 
     Count board_size_;
+    double empty_lines_param_;
+    IntScore empty_lines_param_int_;
     Count mirrors_destroyed_;
     Count empty_lines_count_;
 
@@ -451,7 +478,6 @@ private:
     array<vector<char>, 2> mirrors_left_;
 
     shared_ptr<Mirrors> mirrors_;
-    shared_ptr<HashFunction> hash_function_;
     CastHistory_Nodes history_casts_;
     // use for reduce and restore
     shared_ptr<vector<short>> buffer_;
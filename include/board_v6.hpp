@@ -8,14 +8,13 @@
 #pragma once
 
 #include "board_common.hpp"
+#include "ray_cache.hpp"
 
-class Board_v6 : public Board_v2_Reduce {
+class Board_v6 final : public Board_v2_Reduce_Static<Board_v6> {
 private:
     
     using int8_t = short;
     
-    constexpr static size_t HashBitsCount = 64;
-    
     const constexpr static int kDirTop      = 0;
     const constexpr static int kDirBottom   = 1;
     const constexpr static int kDirLeft     = 2;
@@ -34,10 +33,11 @@ private:
     using Mirror = char;
     using Neighbors = array<short, 4>;
     
-    using HashFunction = ZobristHashing<HashBitsCount>;
     using Mirrors = Grid<int8_t>;
 public:
-    using HashType = typename HashFunction::value;
+    using HashType = BoardHash::HashType;
+    // CastRestorable can be called again before Restore
+    using NestedRestore = true_type;
     
 private:
     
@@ -90,6 +90,8 @@ public:
     
     Board_v6(const vector<string>& str_board) : board_size_(str_board.size()),
                                                 hash_(board_size_) {
+        empty_lines_param_ = EmptyLinesParam(board_size_);
+        empty_lines_param_int_ = EmptyLinesParamInt(board_size_);
         mirrors_destroyed_ = 0;
         empty_row_count_ = 0;
         empty_col_count_ = 0;
@@ -106,6 +108,32 @@ public:
         buffer_.reset(new vector<short>());
     }
 
+    Board_v6(const Board_v6&) = default;
+
+    // beam layers assign boards of the same search into used slots:
+    // vectors are copied into existing capacity and shared members are
+    // only reassigned when they differ, to keep ref counts untouched
+    Board_v6& operator=(const Board_v6& b) {
+        Board_v2_Reduce_Static::operator=(b);
+        board_size_ = b.board_size_;
+        empty_lines_param_ = b.empty_lines_param_;
+        empty_lines_param_int_ = b.empty_lines_param_int_;
+        mirrors_destroyed_ = b.mirrors_destroyed_;
+        empty_row_count_ = b.empty_row_count_;
+        empty_col_count_ = b.empty_col_count_;
+        filled_space_ = b.filled_space_;
+        empty_space_ = b.empty_space_;
+        hash_ = b.hash_;
+        items_ = b.items_;
+        ray_direction_ = b.ray_direction_;
+        mirrors_left_ = b.mirrors_left_;
+        if (mirrors_ != b.mirrors_) mirrors_ = b.mirrors_;
+        history_casts_ = b.history_casts_;
+        if (buffer_ != b.buffer_) buffer_ = b.buffer_;
+        ray_cache_ = b.ray_cache_;
+        return *this;
+    }
+
 private:
     
     void InitItems() {
@@ -199,9 +227,11 @@ private:
     
 public:
 
-    Count CastRestorable(short ray_index) override {
-        auto& last = *buffer_; 
-        last.clear();
+    // buffer is a stack of restorable casts: destroyed items of the cast
+    // followed by their count. casts nest, Restore takes back the last one
+    Count CastRestorable(short ray_index) {
+        auto& last = *buffer_;
+        Index start = last.size();
         auto& mirs = *mirrors_; 
         
         Ray ray{ray_index, ray_direction_[ray_index]};
@@ -218,11 +248,13 @@ public:
             ray = NextFromMirror(ray, mirs(r, c));
             mirs(r, c) += kMirOffset;
         }    
-        mirrors_destroyed_ += last.size();
-        return last.size();
+        Count count = last.size() - start;
+        last.push_back(count);
+        mirrors_destroyed_ += count;
+        return count;
     }
     
-    Count CastImpl(short ray_index) override {
+    Count CastImpl(short ray_index) {
         auto& mirs = *mirrors_;
         history_casts_.Push({items_[ray_index].row, items_[ray_index].col}, ray_index);
         
@@ -230,6 +262,7 @@ public:
         Count count = 0;
         while (ray.pos >= ray_direction_.size()) {
             Destroy(items_[ray.pos].row, items_[ray.pos].col);
+            DropRays(ray.pos);
             DestroyLinks(ray.pos);
             ray = NextFromMirror(ray, mirs(items_[ray.pos].row, items_[ray.pos].col));
             ++count;
@@ -240,12 +273,14 @@ public:
         return count;
     }
     
-    void Restore() override {
-        auto& last = *buffer_; 
+    void Restore() {
+        auto& last = *buffer_;
         auto& mirs = *mirrors_;
-        
-        mirrors_destroyed_ -= last.size();
-        while (!last.empty()) {
+
+        Count count = last.back();
+        last.pop_back();
+        mirrors_destroyed_ -= count;
+        for (; count > 0; --count) {
             char r = items_[last.back()].row;
             char c = items_[last.back()].col;
             mirs(r, c) -= kMirOffset;
@@ -283,8 +318,80 @@ public:
         } 
         hash_.HashIn({row, col});
     }
-    
-    
+
+    // cast that is taken back by UndoLogged, any number of them can be stacked.
+    // destroyed items are unlinked and pushed to log, history is untouched.
+    // ray indices have to stay the same, so board shouldn't be reduced meanwhile
+    Count CastLogged(short ray_index, vector<short>& log) {
+        auto& mirs = *mirrors_;
+        Ray ray = NextFromBorder(ray_index);
+        Count count = 0;
+        while (ray.pos >= ray_direction_.size()) {
+            char r = items_[ray.pos].row;
+            char c = items_[ray.pos].col;
+            Destroy(r, c);
+            DropRays(ray.pos);
+            DestroyLinks(ray.pos);
+            log.push_back(ray.pos);
+            ray = NextFromMirror(ray, mirs(r, c));
+            ++count;
+        }
+        empty_space_ += count;
+        filled_space_ -= count;
+        mirrors_destroyed_ += count;
+        return count;
+    }
+
+    // takes back last count items of the log. unlinked item keeps its own links,
+    // so going in reverse order puts every list back as it was
+    void UndoLogged(vector<short>& log, Count count) {
+        empty_space_ -= count;
+        filled_space_ += count;
+        mirrors_destroyed_ -= count;
+        for (; count > 0; --count) {
+            auto index = log.back();
+            log.pop_back();
+            RestoreLinks(index);
+            DropRays(index);
+            Restore(items_[index].row, items_[index].col);
+        }
+    }
+
+    void RestoreLinks(short index) {
+        auto& ns = items_[index].ns;
+        items_[ns[kDirTop]].ns[kDirBottom] = index;
+        items_[ns[kDirBottom]].ns[kDirTop] = index;
+        items_[ns[kDirLeft]].ns[kDirRight] = index;
+        items_[ns[kDirRight]].ns[kDirLeft] = index;
+    }
+
+
+    // rays keep result of CastRestorable while the board is cast in place by
+    // Cast, CastLogged and UndoLogged. ForEachAppliedCast walks only rays
+    // that changed since, for the rest it only shifts counters and hash,
+    // so func should read nothing else of the board
+    void EnableRayCache() {
+        ray_cache_.Reset(ray_direction_.size(), items_.size());
+    }
+
+    template<class Functor>
+    void ForEachAppliedCast(Functor func) {
+        if (!ray_cache_.enabled()) {
+            Board_v2_Reduce_Static<Board_v6>::ForEachAppliedCast(func);
+            return;
+        }
+        Count empty_rays = 0;
+        for (auto i = 0; i < ray_direction_.size(); ++i) {
+            if (!ray_cache_.valid(i)) FillRayCache(i);
+            auto& e = ray_cache_[i];
+            empty_rays += e.count == 0;
+            ApplyRayCache(e, 1);
+            func(i);
+            ApplyRayCache(e, -1);
+        }
+        empty_rays_ = empty_rays;
+    }
+
     void Reduce(vector<short>& shift) {
         Reduce();
         auto& offset = *buffer_;
@@ -294,7 +401,7 @@ public:
     }
     
     // 4 * Number of items
-    void Reduce() override {
+    void Reduce() {
         auto& offset = *buffer_;
         offset.resize(items_.size());
         auto cur = 0;
@@ -342,6 +449,8 @@ public:
         
         empty_space_ = 0;
         filled_space_ = items_.size() - ray_direction_.size();
+        // items and rays are renumbered
+        if (ray_cache_.enabled()) EnableRayCache();
     }
     
     bool IsEmptyLine(short ray_index) {
@@ -349,23 +458,23 @@ public:
         
     }
     
-    bool AllDestroyed() const override {
+    bool AllDestroyed() const {
         return EmptyLinesCount() == 2 * board_size_;
     }
     
-    Count size() const override {
+    Count size() const {
         return board_size_;
     }
     
-    Count RayCount() const override {
+    Count RayCount() const {
         return ray_direction_.size();
     }
     
-    Count MirrorsDestroyed() const override {
+    Count MirrorsDestroyed() const {
         return mirrors_destroyed_;
     }
     
-    Count EmptyLinesCount() const override {
+    Count EmptyLinesCount() const {
         return EmptyColCount() + EmptyRowCount();
     }
 
@@ -376,16 +485,26 @@ public:
     Count EmptyColCount() const {
         return empty_col_count_;
     }
+
+    // counters are kept during every cast, including CastRestorable,
+    // so the child score is read right away
+    double ScoreValue_v1() const {
+        return mirrors_destroyed_ + empty_lines_param_ * (empty_row_count_ + empty_col_count_);
+    }
+
+    IntScore ScoreValue_v1_Int() const {
+        return mirrors_destroyed_ * kScoreOne + empty_lines_param_int_ * (empty_row_count_ + empty_col_count_);
+    }
     
-    HashType hash() const override {
+    HashType hash() const {
         return hash_.hash();
     }
     
-    Count EmptySpace() const override {
+    Count EmptySpace() const {
         return empty_space_;
     }
 
-    Count TotalSpace() const override {
+    Count TotalSpace() const {
         return items_.size();
     }
 
@@ -393,11 +512,11 @@ public:
         return filled_space_;
     }
 
-    Count CastCount() const override {
+    Count CastCount() const {
         return history_casts_.Count();
     }
 
-    vector<Position> CastHistory() const override {
+    vector<Position> CastHistory() const {
         return ToVector(history_casts_);
     }
 
@@ -405,11 +524,57 @@ public:
         return ToRayVector(history_casts_);
     }
 
-    unique_ptr<Board> Clone() const override {
-        return make_unique<Board_v6>(*this);
+
+    // copies share mirrors and buffer that CastRestorable, Restore and Reduce write to.
+    // boards processed by different threads at the same time have to use different scratch
+    void ShareScratch(const Board_v6& b) {
+        if (mirrors_ != b.mirrors_) mirrors_ = b.mirrors_;
+        if (buffer_ != b.buffer_) buffer_ = b.buffer_;
+    }
+
+    void DetachScratch() {
+        mirrors_.reset(new Mirrors(*mirrors_));
+        buffer_.reset(new vector<short>());
+    }
+
+    // search gives its root history own arena and collects it between layers
+    void DetachHistory() {
+        history_casts_.Detach();
+    }
+
+    template<class Boards>
+    static void CollectHistory(const Boards& bs) {
+        CastHistory_Nodes_v2::Collect(bs, [](const Board_v6& b) -> auto& { return b.history_casts_; });
     }
     
 private:
+
+    void FillRayCache(short ray_index) {
+        auto hash = hash_;
+        auto empty_rows = empty_row_count_;
+        auto empty_cols = empty_col_count_;
+        Count count = CastRestorable(ray_index);
+        RayCache::Entry e{hash_.delta(hash), short(count),
+                          char(empty_row_count_ - empty_rows), char(empty_col_count_ - empty_cols)};
+        // count is on top, items of the cast right below
+        auto end = buffer_->end() - 1;
+        ray_cache_.Record(ray_index, e, end - count, end);
+        Restore();
+    }
+
+    void ApplyRayCache(const RayCache::Entry& e, int sign) {
+        mirrors_destroyed_ += sign * e.count;
+        empty_row_count_ += sign * e.empty_rows;
+        empty_col_count_ += sign * e.empty_cols;
+        hash_.Apply(e.hash);
+    }
+
+    // item was destroyed or restored
+    void DropRays(short index) {
+        if (!ray_cache_.enabled()) return;
+        ray_cache_.Drop(index);
+        for (auto n : items_[index].ns) ray_cache_.Drop(n);
+    }
     
     Ray NextFromMirror(const Ray& ray, char mir) const {
         Direction dir = kDirReflection[mir][ray.dir];
@@ -428,6 +593,8 @@ private:
 
 
     Count board_size_;
+    double empty_lines_param_;
+    IntScore empty_lines_param_int_;
     Count mirrors_destroyed_;
     Count empty_row_count_;
     Count empty_col_count_;
@@ -447,5 +614,6 @@ private:
     CastHistory_Nodes_v2 history_casts_;
     // use for reduce and restore
     shared_ptr<vector<short>> buffer_;
+    RayCache ray_cache_;
 
 };
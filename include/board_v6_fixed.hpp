@@ -0,0 +1,488 @@
+//
+// Created by Anton Logunov on 5/26/17.
+//
+#pragma once
+
+#include "board_common.hpp"
+#include "board_v6.hpp"
+
+
+// same as Board_v6 with size known at compile time.
+// items, directions and line counters live inside the board, so copy is
+// a plain copy of used part of the arrays and never allocates.
+// mirror grid, hash keys and border layout use constant strides
+template<Count N>
+class Board_v6_Fixed final : public Board_v2_Reduce_Static<Board_v6_Fixed<N>> {
+private:
+
+    const constexpr static int kDirTop      = 0;
+    const constexpr static int kDirBottom   = 1;
+    const constexpr static int kDirLeft     = 2;
+    const constexpr static int kDirRight    = 3;
+
+    const constexpr static char kMirRight     = 0;
+    const constexpr static char kMirLeft      = 1;
+    const constexpr static char kMirOffset    = 3;
+
+    const constexpr static char kOrientHor = 0;
+    const constexpr static char kOrientVer = 1;
+
+    const constexpr static Count kRayCapacity = 4*N;
+    const constexpr static Count kItemCapacity = 4*N + N*N;
+
+    using Direction = char;
+    using Mirror = char;
+    using Mirrors = array<array<Mirror, N>, N>;
+
+public:
+    using HashType = BoardHash::HashType;
+    // CastRestorable can be called again before Restore
+    using NestedRestore = true_type;
+
+private:
+
+    struct Ray {
+        Ray(short pos, Direction dir)
+        : pos(pos), dir(dir) {}
+
+        short pos;
+        Direction dir;
+    };
+
+    struct Item {
+        array<short, 4> ns;
+        char row;
+        char col;
+    };
+
+    // first index mirror type
+    // second index where ray going
+    // result direction where will go
+    constexpr const static array<array<char, 4>, 2> kDirReflection = { {
+        // kMirRight
+        { {
+            kDirLeft,  // to top
+            kDirRight,   // to bottom
+            kDirTop, // to left
+            kDirBottom     // to right
+        } },
+        // kMirLeft
+        { {
+            kDirRight,   // to top
+            kDirLeft,  // to bottom
+            kDirBottom,    // to left
+            kDirTop  // to right
+        } }
+    } };
+
+public:
+
+    Board_v6_Fixed() {}
+
+    Board_v6_Fixed(const vector<string>& str_board) {
+        assert(str_board.size() == N);
+        empty_lines_param_ = EmptyLinesParam(N);
+        empty_lines_param_int_ = EmptyLinesParamInt(N);
+        mirrors_destroyed_ = 0;
+        empty_row_count_ = 0;
+        empty_col_count_ = 0;
+
+        filled_space_ = N*N;
+        empty_space_ = 0;
+
+        InitItems();
+        mirrors_left_[kOrientHor].fill(N);
+        mirrors_left_[kOrientVer].fill(N);
+        InitHash();
+
+        InitMirrors(str_board);
+        buffer_.reset(new vector<short>());
+    }
+
+    Board_v6_Fixed(const Board_v6_Fixed& b) : Board_v2_Reduce_Static<Board_v6_Fixed>(b) {
+        CopyState(b);
+    }
+
+    Board_v6_Fixed& operator=(const Board_v6_Fixed& b) {
+        Board_v2_Reduce_Static<Board_v6_Fixed>::operator=(b);
+        CopyState(b);
+        return *this;
+    }
+
+private:
+
+    // reduced board copies only items it still has
+    void CopyState(const Board_v6_Fixed& b) {
+        empty_lines_param_ = b.empty_lines_param_;
+        empty_lines_param_int_ = b.empty_lines_param_int_;
+        mirrors_destroyed_ = b.mirrors_destroyed_;
+        empty_row_count_ = b.empty_row_count_;
+        empty_col_count_ = b.empty_col_count_;
+        filled_space_ = b.filled_space_;
+        empty_space_ = b.empty_space_;
+        keys_ = b.keys_;
+        hash_ = b.hash_;
+        item_count_ = b.item_count_;
+        ray_count_ = b.ray_count_;
+        copy_n(b.items_.begin(), item_count_, items_.begin());
+        copy_n(b.ray_direction_.begin(), ray_count_, ray_direction_.begin());
+        mirrors_left_ = b.mirrors_left_;
+        if (mirrors_ != b.mirrors_) mirrors_ = b.mirrors_;
+        history_casts_ = b.history_casts_;
+        if (buffer_ != b.buffer_) buffer_ = b.buffer_;
+    }
+
+    constexpr static short ToIndex(int r, int c) {
+        return r * N + c + kRayCapacity;
+    }
+
+    void InitItems() {
+        item_count_ = kItemCapacity;
+        ray_count_ = kRayCapacity;
+
+        // initializing inner links
+        for (int r = 0; r < N; ++r) {
+            for (int c = 0; c < N; ++c) {
+                auto& t = items_[ToIndex(r, c)];
+                t.ns[kDirTop] = ToIndex(r-1, c);
+                t.ns[kDirRight] = ToIndex(r, c+1);
+                t.ns[kDirBottom] = ToIndex(r+1, c);
+                t.ns[kDirLeft] = ToIndex(r, c-1);
+                t.row = r;
+                t.col = c;
+            }
+        }
+        // initializing border links
+        for (int i = 0; i < N; ++i) {
+            InitBorder(4*i + kDirTop, ToIndex(0, i), kDirBottom, -1, i);
+            InitBorder(4*i + kDirRight, ToIndex(i, N-1), kDirLeft, i, N);
+            InitBorder(4*i + kDirBottom, ToIndex(N-1, i), kDirTop, N, i);
+            InitBorder(4*i + kDirLeft, ToIndex(i, 0), kDirRight, i, -1);
+        }
+    }
+
+    // b_i border index, m_i mirror index next to it, dir looks into the board
+    void InitBorder(int b_i, int m_i, Direction dir, char row, char col) {
+        auto& b = items_[b_i];
+        b.ns.fill(-1);
+        b.ns[dir] = m_i;
+        b.row = row;
+        b.col = col;
+        ray_direction_[b_i] = dir;
+        items_[m_i].ns[dir ^ 1] = b_i;
+    }
+
+    void InitMirrors(const vector<string>& str_board) {
+        mirrors_.reset(new Mirrors());
+        auto& mirs = *mirrors_;
+        for (auto r = 0; r < N; ++r) {
+            for (auto c = 0; c < N; ++c) {
+                mirs[r][c] = IsRightMirror(str_board[r][c]) ? kMirRight : kMirLeft;
+            }
+        }
+    }
+
+    // same keys as BoardHash of the size, so hashes match Board_v6
+    void InitHash() {
+        keys_ = ZobristTable::ForSize(N).keys();
+        hash_ = 0;
+        for (auto i = 0; i < N*N; ++i) {
+            hash_ ^= keys_[i];
+        }
+    }
+
+public:
+
+    // buffer is a stack of restorable casts: destroyed items of the cast
+    // followed by their count. casts nest, Restore takes back the last one
+    Count CastRestorable(short ray_index) {
+        auto& last = *buffer_;
+        Index start = last.size();
+        auto& mirs = *mirrors_;
+
+        Ray ray{ray_index, ray_direction_[ray_index]};
+        ray = NextFromEmpty(ray);
+        while (ray.pos >= ray_count_) {
+            char r = items_[ray.pos].row;
+            char c = items_[ray.pos].col;
+            if (mirs[r][c] >= kMirOffset) {
+                ray = NextFromEmpty(ray);
+                continue;
+            }
+            last.push_back(ray.pos);
+            Destroy(r, c);
+            ray = NextFromMirror(ray, mirs[r][c]);
+            mirs[r][c] += kMirOffset;
+        }
+        Count count = last.size() - start;
+        last.push_back(count);
+        mirrors_destroyed_ += count;
+        return count;
+    }
+
+    Count CastImpl(short ray_index) {
+        auto& mirs = *mirrors_;
+        history_casts_.Push({items_[ray_index].row, items_[ray_index].col}, ray_index);
+
+        Ray ray = NextFromBorder(ray_index);
+        Count count = 0;
+        while (ray.pos >= ray_count_) {
+            char r = items_[ray.pos].row;
+            char c = items_[ray.pos].col;
+            Destroy(r, c);
+            DestroyLinks(ray.pos);
+            ray = NextFromMirror(ray, mirs[r][c]);
+            ++count;
+        }
+        empty_space_ += count;
+        filled_space_ -= count;
+        mirrors_destroyed_ += count;
+        return count;
+    }
+
+    void Restore() {
+        auto& last = *buffer_;
+        auto& mirs = *mirrors_;
+
+        Count count = last.back();
+        last.pop_back();
+        mirrors_destroyed_ -= count;
+        for (; count > 0; --count) {
+            char r = items_[last.back()].row;
+            char c = items_[last.back()].col;
+            mirs[r][c] -= kMirOffset;
+            Restore(r, c);
+            last.pop_back();
+        }
+    }
+
+    void Destroy(char row, char col) {
+        if (--mirrors_left_[kOrientHor][col] == 0) {
+            ++empty_row_count_;
+        }
+        if (--mirrors_left_[kOrientVer][row] == 0) {
+            ++empty_col_count_;
+        }
+        hash_ ^= keys_[row*N + col];
+    }
+
+    void DestroyLinks(short index) {
+        auto& ns = items_[index].ns;
+        items_[ns[kDirTop]].ns[kDirBottom] = ns[kDirBottom];
+        items_[ns[kDirBottom]].ns[kDirTop] = ns[kDirTop];
+        items_[ns[kDirLeft]].ns[kDirRight] = ns[kDirRight];
+        items_[ns[kDirRight]].ns[kDirLeft] = ns[kDirLeft];
+    }
+
+    void Restore(char row, char col) {
+        if (++mirrors_left_[kOrientHor][col] == 1) {
+            --empty_row_count_;
+        }
+        if (++mirrors_left_[kOrientVer][row] == 1) {
+            --empty_col_count_;
+        }
+        hash_ ^= keys_[row*N + col];
+    }
+
+    // same compaction as Board_v6, counts shrink instead of vectors
+    void Reduce() {
+        auto& offset = *buffer_;
+        offset.resize(item_count_);
+        auto cur = 0;
+        for (auto i = 0; i < ray_count_; ++i) {
+            if (IsEmptyLine(i)) {
+                ++cur;
+            }
+            offset[i] = cur;
+        }
+        for (auto i = ray_count_; i < item_count_; ++i) {
+            if (items_[items_[i].ns[kDirTop]].ns[kDirBottom] != i) {
+                ++cur;
+            }
+            offset[i] = cur;
+        }
+        if (offset[0] == 0) {
+            short& p = items_[0].ns[ray_direction_[0]];
+            p -= offset[p];
+        }
+        for (auto i = 1; i < ray_count_; ++i) {
+            if (offset[i-1] != offset[i]) {
+                // increased cur on i pos: deleted element
+                continue;
+            }
+            short& p = items_[i].ns[ray_direction_[i]];
+            p -= offset[p];
+            items_[i - offset[i]] = items_[i];
+            ray_direction_[i - offset[i]] = ray_direction_[i];
+        }
+        for (auto i = ray_count_; i < item_count_; ++i) {
+            if (offset[i-1] != offset[i]) {
+                continue;
+            }
+            auto& ns = items_[i].ns;
+            for (int q = 0; q < 4; ++q) {
+                ns[q] -= offset[ns[q]];
+            }
+            items_[i - offset[i]] = items_[i];
+        }
+        ray_count_ -= offset[ray_count_-1];
+        item_count_ -= offset[item_count_-1];
+
+        empty_space_ = 0;
+        filled_space_ = item_count_ - ray_count_;
+    }
+
+    bool IsEmptyLine(short ray_index) {
+        return NextFromBorder(ray_index).pos < ray_count_;
+    }
+
+    bool AllDestroyed() const {
+        return EmptyLinesCount() == 2 * N;
+    }
+
+    Count size() const {
+        return N;
+    }
+
+    Count RayCount() const {
+        return ray_count_;
+    }
+
+    Count MirrorsDestroyed() const {
+        return mirrors_destroyed_;
+    }
+
+    Count EmptyLinesCount() const {
+        return empty_col_count_ + empty_row_count_;
+    }
+
+    double ScoreValue_v1() const {
+        return mirrors_destroyed_ + empty_lines_param_ * (empty_row_count_ + empty_col_count_);
+    }
+
+    IntScore ScoreValue_v1_Int() const {
+        return mirrors_destroyed_ * kScoreOne + empty_lines_param_int_ * (empty_row_count_ + empty_col_count_);
+    }
+
+    HashType hash() const {
+        return HashType(hash_);
+    }
+
+    Count EmptySpace() const {
+        return empty_space_;
+    }
+
+    Count TotalSpace() const {
+        return item_count_;
+    }
+
+    Count CastCount() const {
+        return history_casts_.Count();
+    }
+
+    vector<Position> CastHistory() const {
+        return ToVector(history_casts_);
+    }
+
+    vector<short> CastRayHistory() const {
+        return ToRayVector(history_casts_);
+    }
+
+
+    // same sharing rules as Board_v6
+    void ShareScratch(const Board_v6_Fixed& b) {
+        if (mirrors_ != b.mirrors_) mirrors_ = b.mirrors_;
+        if (buffer_ != b.buffer_) buffer_ = b.buffer_;
+    }
+
+    void DetachScratch() {
+        mirrors_.reset(new Mirrors(*mirrors_));
+        buffer_.reset(new vector<short>());
+    }
+
+    void DetachHistory() {
+        history_casts_.Detach();
+    }
+
+    template<class Boards>
+    static void CollectHistory(const Boards& bs) {
+        CastHistory_Nodes_v2::Collect(bs, [](const Board_v6_Fixed& b) -> auto& { return b.history_casts_; });
+    }
+
+private:
+
+    Ray NextFromMirror(const Ray& ray, char mir) const {
+        Direction dir = kDirReflection[mir][ray.dir];
+        return {items_[ray.pos].ns[dir], dir};
+    }
+
+    Ray NextFromBorder(short ray_index) const {
+        Direction dir = ray_direction_[ray_index];
+        return {items_[ray_index].ns[dir], dir};
+    }
+
+    Ray NextFromEmpty(const Ray& ray) const {
+        return {items_[ray.pos].ns[ray.dir], ray.dir};
+    }
+
+
+    double empty_lines_param_;
+    IntScore empty_lines_param_int_;
+    Count mirrors_destroyed_;
+    Count empty_row_count_;
+    Count empty_col_count_;
+
+    Count filled_space_;
+    Count empty_space_;
+
+    // zobrist keys of the size, cell index is row*N + col
+    const uint64_t* keys_{nullptr};
+    uint64_t hash_{0};
+
+    // used prefixes of items_ and ray_direction_, shrink on Reduce
+    Count item_count_{0};
+    Count ray_count_{0};
+    // rays are first in items
+    array<Item, kItemCapacity> items_;
+    array<Direction, kRayCapacity> ray_direction_;
+    array<array<char, N>, 2> mirrors_left_;
+
+    shared_ptr<Mirrors> mirrors_;
+    CastHistory_Nodes_v2 history_casts_;
+    // use for reduce and restore
+    shared_ptr<vector<short>> buffer_;
+};
+
+template<Count N>
+constexpr const array<array<char, 4>, 2> Board_v6_Fixed<N>::kDirReflection;
+
+
+// every size is one more instantiation of whatever func runs, engines
+// included, so only a few sizes across the range get their own board
+using BoardFixedSizes = integer_sequence<Count, 50, 60, 70, 80, 90, 100>;
+
+template<Count N, class Func>
+auto CallWithBoard_v6_Fixed(const vector<string>& str_board, Func& func) {
+    return func(Board_v6_Fixed<N>(str_board));
+}
+
+// one call per size in a table: only the board of matching size is
+// constructed, in the frame of its own call
+template<class Func, Count... Sizes>
+auto WithBoard_v6_Fixed(const vector<string>& str_board, Func& func, integer_sequence<Count, Sizes...>) {
+    using Result = decltype(func(Board_v6(str_board)));
+    using Call = Result (*)(const vector<string>&, Func&);
+    static constexpr Count sizes[] = {Sizes...};
+    static constexpr Call calls[] = {&CallWithBoard_v6_Fixed<Sizes, Func>...};
+    for (Index i = 0; i < Count(sizeof...(Sizes)); ++i) {
+        if (sizes[i] == str_board.size()) return calls[i](str_board, func);
+    }
+    return func(Board_v6(str_board));
+}
+
+// func is called with Board_v6_Fixed of board size if it's one of
+// BoardFixedSizes, with Board_v6 otherwise. func should be generic over the board type
+template<class Func>
+auto WithBoard_v6_Fixed(const vector<string>& str_board, Func func) {
+    return WithBoard_v6_Fixed(str_board, func, BoardFixedSizes());
+}
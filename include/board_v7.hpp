@@ -0,0 +1,340 @@
+//
+//  board_v7.hpp
+//  FRAGILE_MIRRORS
+//
+//  Created by Anton Logunov on 5/8/17.
+//
+// mirrors are kept as bitboards: occupancy mask for every row and every column.
+// next mirror along the ray is the lowest or highest set bit of the masked line,
+// so there are no links to update and nothing to reduce
+#pragma once
+
+#include "board_common.hpp"
+
+
+class Board_v7 final : public Board_v2_Reduce_Static<Board_v7> {
+private:
+
+    using Mask = unsigned __int128;
+
+    constexpr static Count kMaxSize = 100;
+
+    const constexpr static int kDirTop      = 0;
+    const constexpr static int kDirBottom   = 1;
+    const constexpr static int kDirLeft     = 2;
+    const constexpr static int kDirRight    = 3;
+
+    const constexpr static char kMirRight     = 0;
+    const constexpr static char kMirLeft      = 1;
+
+    using Direction = char;
+    using Lines = array<Mask, kMaxSize>;
+
+public:
+    using HashType = BoardHash::HashType;
+
+private:
+
+    // first index mirror type
+    // second index where ray going
+    // result direction where will go
+    constexpr const static array<array<char, 4>, 2> kDirReflection = { {
+        // kMirRight
+        { {
+            kDirLeft,  // to top
+            kDirRight,   // to bottom
+            kDirTop, // to left
+            kDirBottom     // to right
+        } },
+        // kMirLeft
+        { {
+            kDirRight,   // to top
+            kDirLeft,  // to bottom
+            kDirBottom,    // to left
+            kDirTop  // to right
+        } }
+    } };
+
+    struct Ray {
+        short row;
+        short col;
+        Direction dir;
+    };
+
+public:
+
+    Board_v7() {}
+
+    Board_v7(const vector<string>& str_board) : board_size_(str_board.size()),
+                                                hash_(board_size_) {
+        assert(board_size_ <= kMaxSize);
+        empty_lines_param_ = EmptyLinesParam(board_size_);
+        empty_lines_param_int_ = EmptyLinesParamInt(board_size_);
+        mirrors_destroyed_ = 0;
+        empty_row_count_ = 0;
+        empty_col_count_ = 0;
+
+        rows_.fill(0);
+        cols_.fill(0);
+        right_mirrors_.fill(0);
+        for (auto r = 0; r < board_size_; ++r) {
+            for (auto c = 0; c < board_size_; ++c) {
+                rows_[r] |= Bit(c);
+                cols_[c] |= Bit(r);
+                if (IsRightMirror(str_board[r][c])) {
+                    right_mirrors_[r] |= Bit(c);
+                }
+                hash_.HashIn(r, c);
+            }
+        }
+    }
+
+    Count CastRestorable(short ray_index) {
+        restore_buffer_.clear();
+        auto count = Walk(ray_index, [&](short r, short c) {
+            restore_buffer_.push_back(r * board_size_ + c);
+        });
+        mirrors_destroyed_ += count;
+        return count;
+    }
+
+    Count CastImpl(short ray_index) {
+        auto ray = BorderRay(ray_index);
+        history_casts_.Push({ray.row, ray.col}, ray_index);
+        auto count = Walk(ray_index, [](short, short) {});
+        mirrors_destroyed_ += count;
+        return count;
+    }
+
+    void Restore() {
+        mirrors_destroyed_ -= restore_buffer_.size();
+        for (auto i : restore_buffer_) {
+            Restore(i / board_size_, i % board_size_);
+        }
+        restore_buffer_.clear();
+    }
+
+    // nothing to compact
+    void Reduce() {}
+
+    // hides the one that counts empty rays and then calls Reduce for nothing
+    bool ReduceIfWorth() {
+        return false;
+    }
+
+    bool IsEmptyLine(short ray_index) const {
+        auto ray = BorderRay(ray_index);
+        return ray.dir == kDirLeft || ray.dir == kDirRight ? rows_[ray.row] == 0 : cols_[ray.col] == 0;
+    }
+
+    bool AllDestroyed() const {
+        return EmptyLinesCount() == 2 * board_size_;
+    }
+
+    Count size() const {
+        return board_size_;
+    }
+
+    // rays of empty lines stay, they just destroy nothing
+    Count RayCount() const {
+        return 4 * board_size_;
+    }
+
+    Count MirrorsDestroyed() const {
+        return mirrors_destroyed_;
+    }
+
+    Count EmptyLinesCount() const {
+        return empty_row_count_ + empty_col_count_;
+    }
+
+    Count EmptyRowCount() const {
+        return empty_row_count_;
+    }
+
+    Count EmptyColCount() const {
+        return empty_col_count_;
+    }
+
+    // rows and columns with even number of mirrors left, empty ones excluded
+    Count EvenLinesCount() const {
+        Count count = 0;
+        for (auto i = 0; i < board_size_; ++i) {
+            count += (PopCount(rows_[i]) & 1) == 0;
+            count += (PopCount(cols_[i]) & 1) == 0;
+        }
+        return count - EmptyLinesCount();
+    }
+
+    double ScoreValue_v1() const {
+        return mirrors_destroyed_ + empty_lines_param_ * (empty_row_count_ + empty_col_count_);
+    }
+
+    IntScore ScoreValue_v1_Int() const {
+        return mirrors_destroyed_ * kScoreOne + empty_lines_param_int_ * (empty_row_count_ + empty_col_count_);
+    }
+
+    HashType hash() const {
+        return hash_.hash();
+    }
+
+    Count EmptySpace() const {
+        return 0;
+    }
+
+    Count TotalSpace() const {
+        return board_size_ * board_size_;
+    }
+
+    Count CastCount() const {
+        return history_casts_.Count();
+    }
+
+    vector<Position> CastHistory() const {
+        return ToVector(history_casts_);
+    }
+
+    vector<short> CastRayHistory() const {
+        return ToRayVector(history_casts_);
+    }
+
+
+    // every board owns all its state
+    void ShareScratch(const Board_v7& b) {}
+
+    void DetachScratch() {}
+
+    // search gives its root history own arena and collects it between layers
+    void DetachHistory() {
+        history_casts_.Detach();
+    }
+
+    template<class Boards>
+    static void CollectHistory(const Boards& bs) {
+        CastHistory_Nodes_v2::Collect(bs, [](const Board_v7& b) -> auto& { return b.history_casts_; });
+    }
+
+private:
+
+    static Mask Bit(Index i) {
+        return Mask(1) << i;
+    }
+
+    // bits strictly greater than i, i can be -1
+    static Mask Above(Index i) {
+        return ~Mask(0) << (i + 1);
+    }
+
+    // bits strictly less than i
+    static Mask Below(Index i) {
+        return Bit(i) - 1;
+    }
+
+    static Index LowestBit(Mask m) {
+        auto lo = static_cast<uint64_t>(m);
+        return lo != 0 ? __builtin_ctzll(lo) : 64 + __builtin_ctzll(static_cast<uint64_t>(m >> 64));
+    }
+
+    static Index HighestBit(Mask m) {
+        auto hi = static_cast<uint64_t>(m >> 64);
+        return hi != 0 ? 127 - __builtin_clzll(hi) : 63 - __builtin_clzll(static_cast<uint64_t>(m));
+    }
+
+    static Count PopCount(Mask m) {
+        return __builtin_popcountll(static_cast<uint64_t>(m)) + __builtin_popcountll(static_cast<uint64_t>(m >> 64));
+    }
+
+    // same ray order as Board_v6 before any reduce
+    Ray BorderRay(short ray_index) const {
+        short i = ray_index / 4;
+        switch (ray_index % 4) {
+            case kDirTop: return {-1, i, kDirBottom};
+            case kDirBottom: return {(short)board_size_, i, kDirTop};
+            case kDirLeft: return {i, -1, kDirRight};
+            default: return {i, (short)board_size_, kDirLeft};
+        }
+    }
+
+    // moves ray to next mirror, returns false if ray leaves the board
+    bool NextMirror(Ray& ray) const {
+        Mask m;
+        switch (ray.dir) {
+            case kDirRight:
+                m = rows_[ray.row] & Above(ray.col);
+                if (m == 0) return false;
+                ray.col = LowestBit(m);
+                break;
+            case kDirLeft:
+                m = rows_[ray.row] & Below(ray.col);
+                if (m == 0) return false;
+                ray.col = HighestBit(m);
+                break;
+            case kDirBottom:
+                m = cols_[ray.col] & Above(ray.row);
+                if (m == 0) return false;
+                ray.row = LowestBit(m);
+                break;
+            default:
+                m = cols_[ray.col] & Below(ray.row);
+                if (m == 0) return false;
+                ray.row = HighestBit(m);
+                break;
+        }
+        return true;
+    }
+
+    template<class Func>
+    Count Walk(short ray_index, Func on_destroy) {
+        auto ray = BorderRay(ray_index);
+        Count count = 0;
+        while (NextMirror(ray)) {
+            char mir = (right_mirrors_[ray.row] & Bit(ray.col)) ? kMirRight : kMirLeft;
+            Destroy(ray.row, ray.col);
+            on_destroy(ray.row, ray.col);
+            ray.dir = kDirReflection[mir][ray.dir];
+            ++count;
+        }
+        return count;
+    }
+
+    void Destroy(short row, short col) {
+        if ((rows_[row] &= ~Bit(col)) == 0) {
+            ++empty_row_count_;
+        }
+        if ((cols_[col] &= ~Bit(row)) == 0) {
+            ++empty_col_count_;
+        }
+        hash_.HashOut({row, col});
+    }
+
+    void Restore(short row, short col) {
+        if (rows_[row] == 0) {
+            --empty_row_count_;
+        }
+        rows_[row] |= Bit(col);
+        if (cols_[col] == 0) {
+            --empty_col_count_;
+        }
+        cols_[col] |= Bit(row);
+        hash_.HashIn({row, col});
+    }
+
+
+    Count board_size_;
+    double empty_lines_param_;
+    IntScore empty_lines_param_int_;
+    Count mirrors_destroyed_;
+    Count empty_row_count_;
+    Count empty_col_count_;
+
+    // bit for every mirror left
+    Lines rows_;
+    Lines cols_;
+    // bit for every '\' mirror, never changes
+    Lines right_mirrors_;
+
+    BoardHash hash_;
+    CastHistory_Nodes_v2 history_casts_;
+    // cells destroyed by last restorable cast
+    vector<short> restore_buffer_;
+};
@@ -0,0 +1,499 @@
+//
+//  board_v8.hpp
+//  FRAGILE_MIRRORS
+//
+//  Created by Anton Logunov on 5/14/17.
+//
+// same as Board_v6, but mirror type and destroyed mark live in the item
+// next to its links: a ray step touches one item instead of item and mirror grid.
+// nothing is shared between copies except buffer
+#pragma once
+
+#include "board_common.hpp"
+
+class Board_v8 final : public Board_v2_Reduce_Static<Board_v8> {
+private:
+    
+    using int8_t = short;
+    
+    const constexpr static int kDirTop      = 0;
+    const constexpr static int kDirBottom   = 1;
+    const constexpr static int kDirLeft     = 2;
+    const constexpr static int kDirRight    = 3;
+    const constexpr static int kDirNothing  = 4;
+    
+    const constexpr static char kMirRight     = 0;
+    const constexpr static char kMirLeft      = 1;
+    const constexpr static char kMirBorder    = 2;
+    const constexpr static char kMirOffset    = 3;
+    
+    const constexpr static char kOrientHor = 0;
+    const constexpr static char kOrientVer = 1;
+    
+    using Direction = char;
+    using Mirror = char;
+    using Neighbors = array<short, 4>;
+    
+public:
+    using HashType = BoardHash::HashType;
+    
+private:
+    
+    struct Ray {
+        Ray(short pos, Direction dir) 
+        : pos(pos), dir(dir) {}
+        
+        short pos;
+        Direction dir; 
+    };    
+    
+    // 12 bytes, five items in a cache line
+    struct Item {
+        array<short, 4> ns;
+        char row;
+        char col;
+        // kMirRight or kMirLeft, plus kMirOffset while destroyed by restorable cast
+        Mirror mir;
+    };
+    
+    constexpr const static array<int, 5> kDirOpposite = { {
+        kDirBottom, 
+        kDirTop, 
+        kDirRight, 
+        kDirLeft, 
+        kDirNothing
+    } };
+    
+    // first index mirror type
+    // second index where ray going
+    // result direction where will go  
+    constexpr const static array<array<char, 4>, 2> kDirReflection = { {
+        // kMirRight
+        { {
+            kDirLeft,  // to top
+            kDirRight,   // to bottom
+            kDirTop, // to left
+            kDirBottom     // to right
+        } },
+        // kMirLeft
+        { {
+            kDirRight,   // to top
+            kDirLeft,  // to bottom
+            kDirBottom,    // to left
+            kDirTop  // to right
+        } }
+    } };
+    
+
+public:
+    
+    Board_v8() {}
+    
+    Board_v8(const vector<string>& str_board) : board_size_(str_board.size()),
+                                                hash_(board_size_) {
+        empty_lines_param_ = EmptyLinesParam(board_size_);
+        empty_lines_param_int_ = EmptyLinesParamInt(board_size_);
+        mirrors_destroyed_ = 0;
+        empty_row_count_ = 0;
+        empty_col_count_ = 0;
+        
+        filled_space_ = str_board.size()*str_board.size();
+        empty_space_ = 0;
+        
+        InitItems();
+        mirrors_left_[kOrientHor].resize(board_size_, board_size_);
+        mirrors_left_[kOrientVer].resize(board_size_, board_size_);
+        InitHash();
+        
+        InitMirrors(str_board);
+        buffer_.reset(new vector<short>());
+    }
+
+    Board_v8(const Board_v8&) = default;
+
+    // beam layers assign boards of the same search into used slots:
+    // vectors are copied into existing capacity and shared members are
+    // only reassigned when they differ, to keep ref counts untouched
+    Board_v8& operator=(const Board_v8& b) {
+        Board_v2_Reduce_Static::operator=(b);
+        board_size_ = b.board_size_;
+        empty_lines_param_ = b.empty_lines_param_;
+        empty_lines_param_int_ = b.empty_lines_param_int_;
+        mirrors_destroyed_ = b.mirrors_destroyed_;
+        empty_row_count_ = b.empty_row_count_;
+        empty_col_count_ = b.empty_col_count_;
+        filled_space_ = b.filled_space_;
+        empty_space_ = b.empty_space_;
+        hash_ = b.hash_;
+        items_ = b.items_;
+        ray_direction_ = b.ray_direction_;
+        mirrors_left_ = b.mirrors_left_;
+        history_casts_ = b.history_casts_;
+        if (buffer_ != b.buffer_) buffer_ = b.buffer_;
+        return *this;
+    }
+
+private:
+    
+    void InitItems() {
+        items_.resize(4*board_size_ + board_size_*board_size_);
+        ray_direction_.resize(4*board_size_);
+        
+        // initializing inner links
+        auto offset = 4*board_size_;
+        auto ToIndex = [&](int r, int c) {
+            return r * board_size_ + c + offset;
+        };
+        for (int r = 0; r < board_size_; ++r) {
+            for (int c = 0; c < board_size_; ++c) {
+                Index i = ToIndex(r, c);
+                auto& t = items_[i];
+                t.ns[kDirTop] = ToIndex(r-1, c);
+                t.ns[kDirRight] = ToIndex(r, c+1);
+                t.ns[kDirBottom] = ToIndex(r+1, c);
+                t.ns[kDirLeft] = ToIndex(r, c-1);
+                t.row = r;
+                t.col = c;
+            }
+        }
+        // initializing border links
+        for (int i = 0; i < board_size_; ++i) {
+            int s = 4*i;
+            int m_i; // mirror index
+            int b_i; // border index
+            
+            // TOP
+            m_i = ToIndex(0, i);
+            b_i = s + kDirTop;
+            
+            items_[b_i].ns.fill(-1);
+            items_[b_i].ns[kDirBottom] = m_i;
+            items_[b_i].row = -1;
+            items_[b_i].col = i;
+            ray_direction_[b_i] = kDirBottom;
+            items_[m_i].ns[kDirTop] = b_i;
+            
+            
+            // RIGHT
+            m_i = ToIndex(i, board_size_-1);
+            b_i = s + kDirRight;
+            items_[b_i].ns.fill(-1);
+            items_[b_i].ns[kDirLeft] = m_i;
+            items_[b_i].row = i;
+            items_[b_i].col = board_size_;
+            ray_direction_[b_i] = kDirLeft;
+            items_[m_i].ns[kDirRight] = b_i;
+            
+            // BOTTOM
+            m_i = ToIndex(board_size_-1, i);
+            b_i = s + kDirBottom;
+            items_[b_i].ns.fill(-1);
+            items_[b_i].ns[kDirTop] = m_i;
+            items_[b_i].row = board_size_;
+            items_[b_i].col = i;
+            ray_direction_[b_i] = kDirTop;
+            items_[m_i].ns[kDirBottom] = b_i;
+            
+            // LEFT
+            m_i = ToIndex(i, 0);
+            b_i = s + kDirLeft; 
+            items_[b_i].ns.fill(-1);
+            items_[b_i].ns[kDirRight] = m_i;
+            items_[b_i].row = i;
+            items_[b_i].col = -1;
+            ray_direction_[b_i] = kDirRight;
+            items_[m_i].ns[kDirLeft] = b_i;
+        }
+    }
+    
+    void InitMirrors(const vector<string>& str_board) {
+        for (auto i = ray_direction_.size(); i < items_.size(); ++i) {
+            auto& t = items_[i];
+            t.mir = IsRightMirror(str_board[t.row][t.col]) ? kMirRight : kMirLeft;
+        }
+    }
+    
+    void InitHash() {
+        for (auto r = 0; r < board_size_; ++r) {
+            for (auto c = 0; c < board_size_; ++c) {
+                hash_.HashIn(r, c);
+            }
+        }
+    }
+    
+public:
+
+    Count CastRestorable(short ray_index) {
+        auto& last = *buffer_; 
+        last.clear();
+        
+        Ray ray{ray_index, ray_direction_[ray_index]};
+        ray = NextFromEmpty(ray);
+        while (ray.pos >= ray_direction_.size()) {
+            auto& t = items_[ray.pos];
+            if (t.mir >= kMirOffset) {
+                ray = NextFromEmpty(ray);
+                continue;
+            } 
+            last.push_back(ray.pos);
+            Destroy(t.row, t.col);
+            ray = NextFromMirror(ray, t.mir);
+            t.mir += kMirOffset;
+        }    
+        mirrors_destroyed_ += last.size();
+        return last.size();
+    }
+    
+    Count CastImpl(short ray_index) {
+        history_casts_.Push({items_[ray_index].row, items_[ray_index].col}, ray_index);
+        
+        Ray ray = NextFromBorder(ray_index);
+        Count count = 0;
+        while (ray.pos >= ray_direction_.size()) {
+            auto& t = items_[ray.pos];
+            Destroy(t.row, t.col);
+            DestroyLinks(ray.pos);
+            ray = NextFromMirror(ray, t.mir);
+            ++count;
+        }    
+        empty_space_ += count;
+        filled_space_ -= count;
+        mirrors_destroyed_ += count;
+        return count;
+    }
+    
+    void Restore() {
+        auto& last = *buffer_; 
+        
+        mirrors_destroyed_ -= last.size();
+        while (!last.empty()) {
+            auto& t = items_[last.back()];
+            t.mir -= kMirOffset;
+            Restore(t.row, t.col);
+            last.pop_back();
+        }
+    }
+    
+    void Destroy(char row, char col) {
+        if (--mirrors_left_[kOrientHor][col] == 0) {
+            ++empty_row_count_;
+            // empty is not counted as even?????
+        } 
+        
+        if (--mirrors_left_[kOrientVer][row] == 0) {
+            ++empty_col_count_;
+        }
+        hash_.HashOut({row, col});
+    }
+    
+    void DestroyLinks(short index) {
+        auto& ns = items_[index].ns;
+        items_[ns[kDirTop]].ns[kDirBottom] = ns[kDirBottom];
+        items_[ns[kDirBottom]].ns[kDirTop] = ns[kDirTop];
+        items_[ns[kDirLeft]].ns[kDirRight] = ns[kDirRight];
+        items_[ns[kDirRight]].ns[kDirLeft] = ns[kDirLeft];
+    }
+    
+    void Restore(char row, char col) {
+        if (++mirrors_left_[kOrientHor][col] == 1) {
+            --empty_row_count_;
+        }         
+        if (++mirrors_left_[kOrientVer][row] == 1) {
+            --empty_col_count_;
+        } 
+        hash_.HashIn({row, col});
+    }
+    
+    
+    void Reduce(vector<short>& shift) {
+        Reduce();
+        auto& offset = *buffer_;
+        for (auto& s : shift) {
+            s -= offset[s];
+        }
+    }
+    
+    // 4 * Number of items
+    void Reduce() {
+        auto& offset = *buffer_;
+        offset.resize(items_.size());
+        auto cur = 0;
+        for (auto i = 0; i < ray_direction_.size(); ++i) {
+            if (IsEmptyLine(i)) {
+                ++cur;
+            } 
+            offset[i] = cur;
+        }
+        for (auto i = ray_direction_.size(); i < items_.size(); ++i) {
+            if (items_[items_[i].ns[kDirTop]].ns[kDirBottom] != i) {
+                ++cur;
+            } 
+            offset[i] = cur;
+        }
+        if (offset[0] == 0) {
+            short& p = items_[0].ns[ray_direction_[0]];
+            p -= offset[p];
+        }
+        for (auto i = 1; i < ray_direction_.size(); ++i) {
+            if (offset[i-1] != offset[i]) {
+                // increased cur on i pos: deleted element
+                continue;
+            }
+            short& p = items_[i].ns[ray_direction_[i]];
+            p -= offset[p];
+            items_[i - offset[i]] = items_[i];
+            ray_direction_[i - offset[i]] = ray_direction_[i];
+        }
+        for (auto i = ray_direction_.size(); i < items_.size(); ++i) {
+            if (offset[i-1] != offset[i]) {
+                continue;
+            }
+            auto& ns = items_[i].ns; 
+            for (int q = 0; q < 4; ++q) {
+                ns[q] -= offset[ns[q]];
+            }
+            items_[i - offset[i]] = items_[i];
+        }
+        // now resize both vectors
+        auto last = ray_direction_.size()-1;
+        ray_direction_.resize(last + 1 - offset[last]);
+        last = items_.size()-1;
+        items_.resize(last + 1 - offset[last]);
+        
+        empty_space_ = 0;
+        filled_space_ = items_.size() - ray_direction_.size();
+    }
+    
+    bool IsEmptyLine(short ray_index) {
+        return NextFromBorder(ray_index).pos < RayCount();
+        
+    }
+    
+    bool AllDestroyed() const {
+        return EmptyLinesCount() == 2 * board_size_;
+    }
+    
+    Count size() const {
+        return board_size_;
+    }
+    
+    Count RayCount() const {
+        return ray_direction_.size();
+    }
+    
+    Count MirrorsDestroyed() const {
+        return mirrors_destroyed_;
+    }
+    
+    Count EmptyLinesCount() const {
+        return EmptyColCount() + EmptyRowCount();
+    }
+
+    Count EmptyRowCount() const {
+        return empty_row_count_;
+    }
+
+    Count EmptyColCount() const {
+        return empty_col_count_;
+    }
+
+    // counters are kept during every cast, including CastRestorable,
+    // so the child score is read right away
+    double ScoreValue_v1() const {
+        return mirrors_destroyed_ + empty_lines_param_ * (empty_row_count_ + empty_col_count_);
+    }
+
+    IntScore ScoreValue_v1_Int() const {
+        return mirrors_destroyed_ * kScoreOne + empty_lines_param_int_ * (empty_row_count_ + empty_col_count_);
+    }
+    
+    HashType hash() const {
+        return hash_.hash();
+    }
+    
+    Count EmptySpace() const {
+        return empty_space_;
+    }
+
+    Count TotalSpace() const {
+        return items_.size();
+    }
+
+    Count FilledSpace() const {
+        return filled_space_;
+    }
+
+    Count CastCount() const {
+        return history_casts_.Count();
+    }
+
+    vector<Position> CastHistory() const {
+        return ToVector(history_casts_);
+    }
+
+    vector<short> CastRayHistory() const {
+        return ToRayVector(history_casts_);
+    }
+
+
+    // copies share buffer that CastRestorable, Restore and Reduce write to.
+    // boards processed by different threads at the same time have to use different scratch
+    void ShareScratch(const Board_v8& b) {
+        if (buffer_ != b.buffer_) buffer_ = b.buffer_;
+    }
+
+    void DetachScratch() {
+        buffer_.reset(new vector<short>());
+    }
+
+    // search gives its root history own arena and collects it between layers
+    void DetachHistory() {
+        history_casts_.Detach();
+    }
+
+    template<class Boards>
+    static void CollectHistory(const Boards& bs) {
+        CastHistory_Nodes_v2::Collect(bs, [](const Board_v8& b) -> auto& { return b.history_casts_; });
+    }
+    
+private:
+    
+    Ray NextFromMirror(const Ray& ray, char mir) const {
+        Direction dir = kDirReflection[mir][ray.dir];
+        return {items_[ray.pos].ns[dir], dir};
+    }
+    
+    Ray NextFromBorder(short ray_index) const {
+        Direction dir = ray_direction_[ray_index];
+        return {items_[ray_index].ns[dir], dir};
+    }
+    
+    // same as for FromBorder
+    Ray NextFromEmpty(const Ray& ray) const {
+        return {items_[ray.pos].ns[ray.dir], ray.dir};
+    }
+
+
+    Count board_size_;
+    double empty_lines_param_;
+    IntScore empty_lines_param_int_;
+    Count mirrors_destroyed_;
+    Count empty_row_count_;
+    Count empty_col_count_;
+
+    Count filled_space_;
+    Count empty_space_;
+
+    BoardHash hash_;
+
+    vector<Item> items_;
+    // they are first in items
+    // where is ray directed
+    vector<Direction> ray_direction_;
+    array<vector<char>, 2> mirrors_left_;
+
+    CastHistory_Nodes_v2 history_casts_;
+    // use for reduce and restore
+    shared_ptr<vector<short>> buffer_;
+
+};
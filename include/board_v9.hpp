@@ -0,0 +1,462 @@
+//
+//  board_v9.hpp
+//  FRAGILE_MIRRORS
+//
+//  Created by Anton Logunov on 5/15/17.
+//
+// links of Board_v8 never change here: they live in a topology shared by
+// all boards made from the same one. every board keeps only a bitset of
+// mirrors it destroyed since, rays step over those.
+// Reduce flattens the board into a new topology without destroyed mirrors
+// and empty lines, copies of the board share it again.
+// ShareTopology does the same for a whole layer with mirrors destroyed on every board
+#pragma once
+
+#include "board_common.hpp"
+
+
+class Board_v9 final : public Board_v2_Reduce_Static<Board_v9> {
+private:
+
+    const constexpr static int kDirTop      = 0;
+    const constexpr static int kDirBottom   = 1;
+    const constexpr static int kDirLeft     = 2;
+    const constexpr static int kDirRight    = 3;
+
+    const constexpr static char kMirRight     = 0;
+    const constexpr static char kMirLeft      = 1;
+
+    const constexpr static char kOrientHor = 0;
+    const constexpr static char kOrientVer = 1;
+
+    using Direction = char;
+    using Mirror = char;
+    using Word = uint64_t;
+
+public:
+    using HashType = BoardHash::HashType;
+
+private:
+
+    struct Ray {
+        short pos;
+        Direction dir;
+    };
+
+    struct Item {
+        array<short, 4> ns;
+        char row;
+        char col;
+        Mirror mir;
+    };
+
+    // rays are first items, ray_direction tells where they look
+    struct Topology {
+        vector<Item> items;
+        vector<Direction> ray_direction;
+    };
+
+    // first index mirror type
+    // second index where ray going
+    // result direction where will go
+    constexpr const static array<array<char, 4>, 2> kDirReflection = { {
+        // kMirRight
+        { {
+            kDirLeft,  // to top
+            kDirRight,   // to bottom
+            kDirTop, // to left
+            kDirBottom     // to right
+        } },
+        // kMirLeft
+        { {
+            kDirRight,   // to top
+            kDirLeft,  // to bottom
+            kDirBottom,    // to left
+            kDirTop  // to right
+        } }
+    } };
+
+public:
+
+    Board_v9() {}
+
+    Board_v9(const vector<string>& str_board) : board_size_(str_board.size()),
+                                                hash_(board_size_) {
+        empty_lines_param_ = EmptyLinesParam(board_size_);
+        empty_lines_param_int_ = EmptyLinesParamInt(board_size_);
+        mirrors_destroyed_ = 0;
+        empty_row_count_ = 0;
+        empty_col_count_ = 0;
+        mirrors_left_[kOrientHor].resize(board_size_, board_size_);
+        mirrors_left_[kOrientVer].resize(board_size_, board_size_);
+
+        auto t = make_shared<Topology>();
+        InitTopology(*t, str_board);
+        topology_ = t;
+        destroyed_.resize(WordCount(topology_->items.size()), 0);
+        delta_count_ = 0;
+
+        for (auto r = 0; r < board_size_; ++r) {
+            for (auto c = 0; c < board_size_; ++c) {
+                hash_.HashIn(r, c);
+            }
+        }
+        buffer_.reset(new vector<short>());
+        set_reduce_cost(kReduceCost);
+    }
+
+    Board_v9(const Board_v9&) = default;
+
+    // boards of a layer mostly share topology, buffer and hash function:
+    // pointers are reassigned only when they differ
+    Board_v9& operator=(const Board_v9& b) {
+        Board_v2_Reduce_Static::operator=(b);
+        board_size_ = b.board_size_;
+        empty_lines_param_ = b.empty_lines_param_;
+        empty_lines_param_int_ = b.empty_lines_param_int_;
+        mirrors_destroyed_ = b.mirrors_destroyed_;
+        empty_row_count_ = b.empty_row_count_;
+        empty_col_count_ = b.empty_col_count_;
+        hash_ = b.hash_;
+        if (topology_ != b.topology_) topology_ = b.topology_;
+        destroyed_ = b.destroyed_;
+        delta_count_ = b.delta_count_;
+        mirrors_left_ = b.mirrors_left_;
+        history_casts_ = b.history_casts_;
+        if (buffer_ != b.buffer_) buffer_ = b.buffer_;
+        return *this;
+    }
+
+    Count CastRestorable(short ray_index) {
+        auto& last = *buffer_;
+        last.clear();
+        Walk(ray_index, [&](short pos) {
+            last.push_back(pos);
+        });
+        mirrors_destroyed_ += last.size();
+        delta_count_ += last.size();
+        return last.size();
+    }
+
+    Count CastImpl(short ray_index) {
+        auto& t = topology_->items[ray_index];
+        history_casts_.Push({t.row, t.col}, ray_index);
+        auto count = Walk(ray_index, [](short) {});
+        mirrors_destroyed_ += count;
+        delta_count_ += count;
+        return count;
+    }
+
+    void Restore() {
+        auto& last = *buffer_;
+        mirrors_destroyed_ -= last.size();
+        delta_count_ -= last.size();
+        for (auto pos : last) {
+            auto& t = topology_->items[pos];
+            Restore(t.row, t.col);
+            destroyed_[pos / 64] &= ~Bit(pos);
+        }
+        last.clear();
+    }
+
+    // topology of the board alone, copies made after share it
+    void Reduce() {
+        topology_ = Flatten(*topology_, destroyed_, *buffer_);
+        destroyed_.assign(WordCount(topology_->items.size()), 0);
+        delta_count_ = 0;
+    }
+
+    // boards of a layer that still share topology move to the one without
+    // mirrors destroyed on every board, once there are enough of those.
+    // each board keeps destroyed bits only for the rest
+    template<class Boards>
+    static void ShareTopology(Boards& bs) {
+        if (bs.size() == 0) return;
+        auto& t = bs[0].topology_;
+        vector<Word> common = bs[0].destroyed_;
+        for (auto& b : bs) {
+            if (b.topology_ != t) return;
+            for (Index i = 0; i < common.size(); ++i) common[i] &= b.destroyed_[i];
+        }
+        Count common_count = 0;
+        for (auto w : common) common_count += __builtin_popcountll(w);
+        if (kShareRatio * common_count < t->items.size()) return;
+
+        vector<short> index;
+        auto shared = Flatten(*t, common, index);
+        vector<Word> destroyed(WordCount(shared->items.size()));
+        for (auto& b : bs) {
+            fill(destroyed.begin(), destroyed.end(), 0);
+            for (Index i = 0; i < common.size(); ++i) {
+                for (auto w = b.destroyed_[i] & ~common[i]; w != 0; w &= w - 1) {
+                    auto pos = index[64*i + __builtin_ctzll(w)];
+                    destroyed[pos / 64] |= Bit(pos);
+                }
+            }
+            b.destroyed_.swap(destroyed);
+            b.delta_count_ -= common_count;
+            b.topology_ = shared;
+        }
+    }
+
+    bool IsEmptyLine(short ray_index) const {
+        return Next({ray_index, topology_->ray_direction[ray_index]}).pos < RayCount();
+    }
+
+    bool AllDestroyed() const {
+        return EmptyLinesCount() == 2 * board_size_;
+    }
+
+    Count size() const {
+        return board_size_;
+    }
+
+    Count RayCount() const {
+        return topology_->ray_direction.size();
+    }
+
+    Count MirrorsDestroyed() const {
+        return mirrors_destroyed_;
+    }
+
+    Count EmptyLinesCount() const {
+        return empty_row_count_ + empty_col_count_;
+    }
+
+    Count EmptyRowCount() const {
+        return empty_row_count_;
+    }
+
+    Count EmptyColCount() const {
+        return empty_col_count_;
+    }
+
+    double ScoreValue_v1() const {
+        return mirrors_destroyed_ + empty_lines_param_ * (empty_row_count_ + empty_col_count_);
+    }
+
+    IntScore ScoreValue_v1_Int() const {
+        return mirrors_destroyed_ * kScoreOne + empty_lines_param_int_ * (empty_row_count_ + empty_col_count_);
+    }
+
+    HashType hash() const {
+        return hash_.hash();
+    }
+
+    // destroyed mirrors rays still step over
+    Count EmptySpace() const {
+        return delta_count_;
+    }
+
+    Count TotalSpace() const {
+        return topology_->items.size();
+    }
+
+    Count CastCount() const {
+        return history_casts_.Count();
+    }
+
+    vector<Position> CastHistory() const {
+        return ToVector(history_casts_);
+    }
+
+    vector<short> CastRayHistory() const {
+        return ToRayVector(history_casts_);
+    }
+
+
+    // copies share buffer that CastRestorable, Restore and Reduce write to.
+    // boards processed by different threads at the same time have to use different scratch
+    void ShareScratch(const Board_v9& b) {
+        if (buffer_ != b.buffer_) buffer_ = b.buffer_;
+    }
+
+    void DetachScratch() {
+        buffer_.reset(new vector<short>());
+    }
+
+    // search gives its root history own arena and collects it between layers
+    void DetachHistory() {
+        history_casts_.Detach();
+    }
+
+    template<class Boards>
+    static void CollectHistory(const Boards& bs) {
+        CastHistory_Nodes_v2::Collect(bs, [](const Board_v9& b) -> auto& { return b.history_casts_; });
+    }
+
+    // bytes that a copy of the board doesn't share
+    Count OwnBytes() const {
+        return sizeof(*this) + destroyed_.capacity() * sizeof(Word)
+            + 2 * board_size_ * sizeof(char);
+    }
+
+private:
+
+    static Word Bit(short pos) {
+        return Word(1) << (pos % 64);
+    }
+
+    static Count WordCount(Count item_count) {
+        return (item_count + 63) / 64;
+    }
+
+    static bool IsSet(const vector<Word>& bits, short pos) {
+        return (bits[pos / 64] & Bit(pos)) != 0;
+    }
+
+    // next item in the ray direction that is not removed, border item if none
+    static Ray Next(const Topology& t, const vector<Word>& removed, Ray ray) {
+        short ray_count = t.ray_direction.size();
+        do {
+            ray.pos = t.items[ray.pos].ns[ray.dir];
+        } while (ray.pos >= ray_count && IsSet(removed, ray.pos));
+        return ray;
+    }
+
+    Ray Next(Ray ray) const {
+        return Next(*topology_, destroyed_, ray);
+    }
+
+    // topology without removed items and rays of lines left empty.
+    // index gets new index of every item that stays
+    static shared_ptr<const Topology> Flatten(const Topology& t, const vector<Word>& removed, vector<short>& index) {
+        auto& items = t.items;
+        auto& ray_direction = t.ray_direction;
+        index.assign(items.size(), -1);
+
+        auto res = make_shared<Topology>();
+        for (short i = 0; i < ray_direction.size(); ++i) {
+            if (Next(t, removed, {i, ray_direction[i]}).pos >= ray_direction.size()) {
+                index[i] = res->items.size();
+                res->items.push_back(items[i]);
+                res->ray_direction.push_back(ray_direction[i]);
+            }
+        }
+        for (short i = ray_direction.size(); i < items.size(); ++i) {
+            if (!IsSet(removed, i)) {
+                index[i] = res->items.size();
+                res->items.push_back(items[i]);
+            }
+        }
+        for (short i = 0; i < ray_direction.size(); ++i) {
+            if (index[i] == -1) continue;
+            auto& ns = res->items[index[i]].ns;
+            ns.fill(-1);
+            ns[ray_direction[i]] = index[Next(t, removed, {i, ray_direction[i]}).pos];
+        }
+        for (short i = ray_direction.size(); i < items.size(); ++i) {
+            if (index[i] == -1) continue;
+            auto& ns = res->items[index[i]].ns;
+            for (Direction d = 0; d < 4; ++d) {
+                ns[d] = index[Next(t, removed, {i, d}).pos];
+            }
+        }
+        return res;
+    }
+
+    template<class Func>
+    Count Walk(short ray_index, Func on_destroy) {
+        auto& items = topology_->items;
+        auto ray_count = RayCount();
+        Count count = 0;
+        Ray ray = Next({ray_index, topology_->ray_direction[ray_index]});
+        while (ray.pos >= ray_count) {
+            auto& t = items[ray.pos];
+            Destroy(t.row, t.col);
+            destroyed_[ray.pos / 64] |= Bit(ray.pos);
+            on_destroy(ray.pos);
+            ray.dir = kDirReflection[t.mir][ray.dir];
+            ray = Next(ray);
+            ++count;
+        }
+        return count;
+    }
+
+    void Destroy(char row, char col) {
+        if (--mirrors_left_[kOrientHor][col] == 0) {
+            ++empty_row_count_;
+        }
+        if (--mirrors_left_[kOrientVer][row] == 0) {
+            ++empty_col_count_;
+        }
+        hash_.HashOut({row, col});
+    }
+
+    void Restore(char row, char col) {
+        if (++mirrors_left_[kOrientHor][col] == 1) {
+            --empty_row_count_;
+        }
+        if (++mirrors_left_[kOrientVer][row] == 1) {
+            --empty_col_count_;
+        }
+        hash_.HashIn({row, col});
+    }
+
+    // same layout and ray order as Board_v6
+    void InitTopology(Topology& t, const vector<string>& str_board) {
+        auto& items = t.items;
+        items.resize(4*board_size_ + board_size_*board_size_);
+        t.ray_direction.resize(4*board_size_);
+
+        auto offset = 4*board_size_;
+        auto ToIndex = [&](int r, int c) {
+            return r * board_size_ + c + offset;
+        };
+        for (int r = 0; r < board_size_; ++r) {
+            for (int c = 0; c < board_size_; ++c) {
+                auto& it = items[ToIndex(r, c)];
+                it.ns[kDirTop] = ToIndex(r-1, c);
+                it.ns[kDirRight] = ToIndex(r, c+1);
+                it.ns[kDirBottom] = ToIndex(r+1, c);
+                it.ns[kDirLeft] = ToIndex(r, c-1);
+                it.row = r;
+                it.col = c;
+                it.mir = IsRightMirror(str_board[r][c]) ? kMirRight : kMirLeft;
+            }
+        }
+        auto InitRay = [&](int b_i, int m_i, char row, char col, Direction dir) {
+            items[b_i].ns.fill(-1);
+            items[b_i].ns[dir] = m_i;
+            items[b_i].row = row;
+            items[b_i].col = col;
+            t.ray_direction[b_i] = dir;
+            // mirror looks back to the border
+            static constexpr array<Direction, 4> kOpposite = { {kDirBottom, kDirTop, kDirRight, kDirLeft} };
+            items[m_i].ns[kOpposite[dir]] = b_i;
+        };
+        for (int i = 0; i < board_size_; ++i) {
+            int s = 4*i;
+            InitRay(s + kDirTop, ToIndex(0, i), -1, i, kDirBottom);
+            InitRay(s + kDirRight, ToIndex(i, board_size_-1), i, board_size_, kDirLeft);
+            InitRay(s + kDirBottom, ToIndex(board_size_-1, i), board_size_, i, kDirTop);
+            InitRay(s + kDirLeft, ToIndex(i, 0), i, -1, kDirRight);
+        }
+    }
+
+
+    // layer moves to shared topology when this part of it is destroyed everywhere
+    constexpr static Count kShareRatio = 8;
+    // flattening a single board gives it private topology, in beam search
+    // ShareTopology does most of the work
+    constexpr static double kReduceCost = 16;
+
+    Count board_size_;
+    double empty_lines_param_;
+    IntScore empty_lines_param_int_;
+    Count mirrors_destroyed_;
+    Count empty_row_count_;
+    Count empty_col_count_;
+
+    BoardHash hash_;
+
+    shared_ptr<const Topology> topology_;
+    // bit for every item of topology destroyed since it was made
+    vector<Word> destroyed_;
+    Count delta_count_;
+    array<vector<char>, 2> mirrors_left_;
+
+    CastHistory_Nodes_v2 history_casts_;
+    // use for reduce and restore
+    shared_ptr<vector<short>> buffer_;
+};
@@ -3,6 +3,11 @@
 #include "util.hpp"
 #include "board.hpp"
 #include "score.hpp"
+#include "naive_search.hpp"
+#include "hash_set.hpp"
+#include "board_pool.hpp"
+#include "trace.hpp"
+#include "top_k.hpp"
 
 
 template<class BoardType>
@@ -13,7 +18,7 @@ struct Balancer_1 {
     }
 
 private:
-    int computeLayerProblemSize(const vector<BoardType>& bs) {
+    int computeLayerProblemSize(const BoardPool<BoardType>& bs) {
         return accumulate(bs.begin(), bs.end(), 0, [](int s, const BoardType& b) {
             return s + b.MirrorsLeft();
         });
@@ -21,7 +26,7 @@ private:
 
 public:
 
-    int nextBeamWidth(const vector<BoardType>& curBs, int allowedSize) {
+    int nextBeamWidth(const BoardPool<BoardType>& curBs, int allowedSize) {
         double aveSize = computeLayerProblemSize(curBs) / curBs.size();
         return allowedSize / aveSize;
     }
@@ -40,15 +45,16 @@ private:
         return b.RayCount() * sqrt(b.MirrorsLeft());
     }
 
-    int computeCurrentTotal(const vector<BoardType>& bs) {
+    int computeCurrentTotal(const BoardPool<BoardType>& bs) {
         return accumulate(bs.begin(), bs.end(), 0, [&](int init, const BoardType& b) {
             return init + compute(b);
         });
     }
 
 public:
-    int nextBeamWidth(const vector<BoardType>& bs) {
-        return initialTotal * bs.size() / computeCurrentTotal(bs);
+    int nextBeamWidth(const BoardPool<BoardType>& bs) {
+        // pool size is signed, product overflows int on wide layers
+        return int64_t(initialTotal) * bs.size() / computeCurrentTotal(bs);
     }
 
 private:
@@ -58,20 +64,24 @@ private:
 // score functions that require specific board class as argument
 template<class BoardType, class ScoreType>
 class BeamSearchBalanced {
+    static_assert(IsStaticBoard<BoardType>::value, "board calls would be virtual");
 
     using HashType = typename BoardType::HashType;
     using CastType = typename BoardType::CastType;
+    // double or IntScore
+    using ScoreValue = decltype(declval<const ScoreType&>()(declval<const BoardType&>()));
 
     /// can make use of more parametered possibly
     struct Derivative {
         Derivative() {}
-        Derivative(BoardType* b, const CastType& p, HashType h, double s)
-        : origin(b), cast(p), hash(h), score(s) {}
+        Derivative(BoardType* b, const CastType& p, HashType h, ScoreValue s)
+        : origin(b), hash(h), score(s), cast(p) {}
 
+        // int score and short cast fit into one word after hash
         BoardType* origin;
-        CastType cast;
         HashType hash;
-        double score;
+        ScoreValue score;
+        CastType cast;
 
         /// want to sort in reverse order
         bool operator<(const Derivative& d) const {
@@ -84,27 +94,42 @@ public:
 
 
     BoardType Destroy(const BoardType& b_in) {
-        Balancer_2<Board_v6> balancer(b_in.size(), beam_width_);
+        Balancer_2<BoardType> balancer(b_in.size(), beam_width_);
 
-        unordered_set<HashType> visited;
+        LayerHashSet visited;
         vector<Derivative> derivs;
-        vector<BoardType> b_0;
-        vector<BoardType> b_1;
+        TopK<Derivative> top_k;
+        BoardPool<BoardType> b_0;
+        BoardPool<BoardType> b_1;
         b_0.reserve(beam_width_);
         b_1.reserve(beam_width_);
         Count side_count = 4;
         derivs.reserve(beam_width_*side_count*b_in.size());
         auto cur = &b_0;
         auto next = &b_1;
-        cur->push_back(b_in);
+        // history of layers is collected, boards of the caller shouldn't see that
+        BoardType root = b_in;
+        root.DetachHistory();
+        cur->push_back(root);
+        layer_count_ = 0;
+        trace_.clear();
         Timer timer{std::chrono::duration_cast<std::chrono::milliseconds>(time_).count()};
         while (!timer.timeout()) {
+            TRACE(
+                auto layer_start = TraceClock::now();
+                auto reduce_calls_was = TraceReduceCalls;
+                auto& layer = trace_.NewLayer();
+                layer.boards = cur->size();
+            )
             for (auto& b : *cur) {
+                b.ReduceIfWorth();
                 Count d_was = b.MirrorsDestroyed();
                 auto func = [&](CastType c) {
                     Count d_now = b.MirrorsDestroyed();
-                    if (d_now > d_was && visited.count(b.hash()) == 0) {
-                        visited.insert(b.hash());
+                    if (d_now == d_was) return;
+                    bool fresh = visited.insert(b.hash());
+                    TRACE(++layer.children; layer.dedup_hits += !fresh;)
+                    if (fresh) {
                         derivs.emplace_back(&b, c, b.hash(), score_(b));
                     }
                 };
@@ -112,15 +137,27 @@ public:
             }
 
             // time to pick amount for the next layer
-            Count sz = min<Count>(balancer.nextBeamWidth(*cur), derivs.size());
-            nth_element(derivs.begin(), derivs.begin()+sz-1, derivs.end());
-            derivs.resize(sz);
+            Count width = balancer.nextBeamWidth(*cur);
+            TRACE(
+                layer.width = width;
+                auto select_start = TraceClock::now();
+            )
+            top_k.Select(derivs, width, [](const Derivative& d) { return d.score; });
+            Count sz = derivs.size();
+            TRACE(layer.select_ms = MillisSince(select_start);)
+            TRACE(auto copy_start = TraceClock::now();)
             next->resize(sz);
             for (Index i = 0; i < sz; ++i) {
                 (*next)[i] = *(derivs[i].origin);
                 (*next)[i].Cast(derivs[i].cast);
             }
+            TRACE(
+                layer.copy_ms = MillisSince(copy_start);
+                layer.reduce_calls = TraceReduceCalls - reduce_calls_was;
+                layer.layer_ms = MillisSince(layer_start);
+            )
             swap(cur, next);
+            ++layer_count_;
             auto rr = max_element(cur->begin(), cur->end(), [] (const BoardType& b_0, const BoardType& b_1) {
                 return b_0.MirrorsDestroyed() < b_1.MirrorsDestroyed();
             });
@@ -128,11 +165,19 @@ public:
                 return *rr;
             }
             /// cleanup before next step
+            BoardType::CollectHistory(*cur);
+            BoardType::ShareTopology(*cur);
             next->clear();
             derivs.clear();
             visited.clear();
         }
-        return b_in;
+        // on timeout best board of the layer is finished greedily
+        auto best = max_element(cur->begin(), cur->end(), [&](const BoardType& b_0, const BoardType& b_1) {
+            return score_(b_0) < score_(b_1);
+        });
+        // finish doesn't depend on the score of the search, Score_v1 grows every cast
+        Score_v1 finish;
+        return NaiveSearch<BoardType, Score_v1>().Destroy(*best, finish);
     }
 
     void set_score(ScoreType score) {
@@ -147,7 +192,19 @@ public:
         time_ = time;
     }
 
+    // layers expanded by last Destroy
+    Count layer_count() const {
+        return layer_count_;
+    }
+
+    // empty unless built with FRAGMIR_TRACE
+    const SolveTrace& trace() const {
+        return trace_;
+    }
+
     Count beam_width_;
     ScoreType score_;
     std::chrono::seconds time_{30};
+    Count layer_count_{0};
+    SolveTrace trace_;
 };
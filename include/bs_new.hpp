@@ -4,17 +4,29 @@
 #pragma once
 
 #include <functional>
+#include <mutex>
+#include <atomic>
 
 #include "board_v1_impl_1.hpp"
 #include "naive_search.hpp"
 #include "derivative.hpp"
 #include "discovery.hpp"
+#include "worker_pool.hpp"
 
 using namespace std::placeholders;
 
 
+// with several threads every worker sweeps levels on its own.
+// level that is promoted by another worker is skipped, so workers spread
+// over levels and children of one go straight to the one below.
+// level keeps its own lock, solution and score stats share another one.
+// every board of the search shares history arena of the detached root, it grows
+// by one node per promoted derivative. with one thread history of released
+// parents is collected every so often. workers can't be stopped for that, so
+// with the pool the search ends with solution it has once the arena is full
 template <class Board>
 class BeamSearchNew {
+    static_assert(IsStaticBoard<Board>::value, "board calls would be virtual");
 
     using BoardType = Board;
     using HashType = typename Board::HashType;
@@ -24,31 +36,36 @@ class BeamSearchNew {
     using Derivative_ = Derivative<Board>;
     using LevelDerivatives_ = LevelDerivatives<Derivative_>;
 
+    struct LevelSync {
+        mutex lock;
+        // some worker is promoting the level
+        atomic<bool> busy{false};
+    };
+
 public:
     Board Destroy(const Board& b) {
 		original_ = b;
+		// copies made without history would get an arena each
+		original_.DetachHistory();
 		InitializeSolution();
 
-        PromoteBoardToLevel(b, 0);
+        PromoteBoardToLevel(original_, 0);
 
         // we need some kind of timer here
         // like start and end
         Timer t(millis_);
-		int start_level = 0;
-        while (!t.timeout()) {
-			// should be while solution not found or takes not less than current solution
-            // we start from prominent level
-			for (int i = start_level; i < level_count()-1; ++i) {
-				if (!PromoteLevel(i)) break;
-				if (t.timeout()) {
-					break;
-				}
-            }
-            start_level = ProminentLevel();
+        if (pool_) {
+            vector<Board> scratch(pool_->worker_count(), original_);
+            for (auto& s : scratch) s.DetachScratch();
+            pool_->Run([&](Index w) {
+                Sweep(t, &scratch[w]);
+            });
+        } else {
+            Sweep(t, nullptr);
         }
 
         // lets say i'm in the middle of something
-		
+
 		// serve solution
 		return solution_;
     }
@@ -77,59 +94,161 @@ public:
         millis_ = millis;
     }
 
+    // search also stops after that many promoted derivatives, 0 is no limit.
+    // with one thread the result doesn't depend on the machine then
+    void set_node_budget(Count node_budget) {
+        node_budget_ = node_budget;
+    }
+
+    // derivatives promoted by last Destroy
+    Count nodes() const {
+        return nodes_;
+    }
+
+    // discovered boards are forgotten once it's used up
+    void set_discovery_memory(size_t bytes) {
+        discovery_.set_memory(bytes);
+    }
+
+    void set_thread_count(Count thread_count) {
+        if (thread_count > 1) {
+            pool_ = make_shared<WorkerPool>(thread_count);
+        } else {
+            pool_.reset();
+        }
+    }
+
 private:
+    // levels are allocated once, later solutions only lower level_count_,
+    // so workers never see them moved
     void InitializeSolution() {
-        NaiveSearch<Board, Score> ns;
-        solution_ = ns.Destroy(original_, score_);
-        SetSolution(solution_);
+        NaiveSearch<Board, ScoreType> ns;
+        auto sol = ns.Destroy(original_, score_);
+        Count count = sol.CastCount()-1;
+        level_derivs_.clear();
+        level_derivs_.resize(count);
+        level_sync_ = vector<LevelSync>(count);
+        level_score_stats_.resize(count);
+        level_derivs_used_.assign(count, 0);
         for (auto& stats : level_score_stats_) {
             stats.max = numeric_limits<double>::min();
             stats.min = numeric_limits<double>::max();
         }
+        discovery_.clear();
+        nodes_ = 0;
+        collected_nodes_ = 0;
+        history_full_ = false;
+        level_count_ = count;
+        UpdateScoreStatsWithSolution(sol);
+        solution_ = sol;
+    }
+
+    // should be while solution not found or takes not less than current solution
+    // we start from prominent level
+    void Sweep(Timer t, const Board* scratch) {
+		int start_level = 0;
+        auto done = [&]() {
+            return history_full_ || t.timeout() || (node_budget_ > 0 && nodes_ >= node_budget_);
+        };
+        // exception can't leave worker of the pool
+        try {
+            while (!done()) {
+                for (int i = start_level; i < level_count()-1; ++i) {
+                    if (!PromoteLevel(i, scratch)) break;
+                    if (!pool_) CollectHistoryIfWorth();
+                    if (done()) {
+                        break;
+                    }
+                }
+                start_level = ProminentLevel();
+            }
+        } catch (length_error&) {
+            // history arena is full, levels are left as they are
+            history_full_ = true;
+        }
     }
 
+    // marking walks every live history, so it waits till promoted nodes
+    // outnumber parents that are alive
+    void CollectHistoryIfWorth() {
+        if (nodes_ - collected_nodes_ < collect_period_) return;
+        vector<reference_wrapper<const Board>> live = {original_, solution_};
+        for (auto& ds : level_derivs_) {
+            ds.ForEachParent([&](const Board& b) { live.push_back(b); });
+        }
+        Board::CollectHistory(live);
+        collected_nodes_ = nodes_;
+        collect_period_ = max<Count>(kMinCollectPeriod, live.size());
+    }
 
 	// we can just depend on current soltuion.
 	// we can find current solution with some kind of stupid algorithm.
     int level_count() {
-		return level_derivs_.size();
+		return level_count_;
 	}
 
     // returns false on some kind of failure
-    bool PromoteLevel(int i) {
+    bool PromoteLevel(int i, const Board* scratch) {
+        auto& sync = level_sync_[i];
+        // children of the other worker are on the next level already
+        if (sync.busy.exchange(true)) return true;
 		// best of the best
-        auto promo = level_derivs_[i].ExtractPromotion(promotion_count_);
-        level_derivs_used_[i] += promo.size();
+        vector<Derivative_> promo;
+        {
+            lock_guard<mutex> lock(sync.lock);
+            promo = level_derivs_[i].ExtractPromotion(promotion_count_);
+            level_derivs_used_[i] += promo.size();
+        }
+        nodes_ += promo.size();
         if (promo.empty()) {
+            sync.busy = false;
             return false;
         }
 		UpdateScoreStatsWithLevelPromotion(i, promo);
         // or we could build really big vector and push everything. but to me it could be done like a bunch or lambdas
         bool best_updated = false;
+        // fixed size board is too big for the stack of a worker
+        unique_ptr<Board> b_ptr(new Board());
+        auto& b = *b_ptr;
         for (auto st : promo) {
-            auto b = static_cast<const Board&>(*st.board);
+            {
+                lock_guard<mutex> lock(sync.lock);
+                b = level_derivs_[i].parent(st);
+            }
+            if (scratch) b.ShareScratch(*scratch);
             b.Cast(st.cast);
 			if (b.AllDestroyed()) {
 				SetSolution(b);
 				break;
 			}
-            auto dd = ComputeBoardDerivatives(b);
-            best_updated |= level_derivs_[i+1].PushAll(dd);
+            best_updated |= PushDerivatives(b, i+1);
         }
-        level_derivs_[i+1].Cap();
+        {
+            lock_guard<mutex> lock(sync.lock);
+            level_derivs_[i].Release(promo);
+        }
+        {
+            lock_guard<mutex> lock(level_sync_[i+1].lock);
+            level_derivs_[i+1].Cap();
+        }
+        sync.busy = false;
         return best_updated;
     }
 
 	// should we put it in another data structure???
 	void UpdateScoreStatsWithLevelPromotion(int level, const vector<Derivative_>& derivs) {
-		auto& stats = level_score_stats_[level];
 		auto score_functor = [](const Derivative_& d) {return d.score;};
-		stats.min = min(stats.min, MinElement(derivs.begin(), derivs.end(), score_functor)->score);
-		stats.max = max(stats.max, MaxElement(derivs.begin(), derivs.end(), score_functor)->score);
+		auto d_min = MinElement(derivs.begin(), derivs.end(), score_functor)->score;
+		auto d_max = MaxElement(derivs.begin(), derivs.end(), score_functor)->score;
+		lock_guard<mutex> lock(solution_lock_);
+		auto& stats = level_score_stats_[level];
+		stats.min = min(stats.min, d_min);
+		stats.max = max(stats.max, d_max);
 	}
-	
+
 	void UpdateScoreStatsWithSolution(const Board& board) {
-		Board b = original_;
+		unique_ptr<Board> b_ptr(new Board(original_));
+		auto& b = *b_ptr;
 		auto casts = board.CastRayHistory();
 		// last one is not relevant as we look for even better solutions
 		for (auto i = 0; i < board.CastCount()-1; ++i) {
@@ -137,44 +256,63 @@ private:
 			level_score_stats_[i].best = score_(b);
 		}
 	}
-	
+
 	void SetSolution(const Board& sol) {
+		lock_guard<mutex> lock(solution_lock_);
+		// other worker could have found shorter one meanwhile
+		if (sol.CastCount() >= solution_.CastCount()) return;
 		// set new bound on number of casts
-		level_derivs_.resize(sol.CastCount()-1);
+		Count count = sol.CastCount()-1;
+		level_count_ = count;
+		// dropped levels that nobody promotes give their memory back
+		for (auto i = count; i < level_derivs_.size(); ++i) {
+			auto& sync = level_sync_[i];
+			if (sync.busy.exchange(true)) continue;
+			{
+				lock_guard<mutex> level_lock(sync.lock);
+				level_derivs_[i].clear();
+			}
+			sync.busy = false;
+		}
 		// now we have to update our level_score_stats_
-		level_score_stats_.resize(sol.CastCount()-1);
-        level_derivs_used_.resize(sol.CastCount()-1);
 		UpdateScoreStatsWithSolution(sol);
 		solution_ = sol;
 	}
-	
+
     void PromoteBoardToLevel(const Board& b, int level) {
-		auto derivs = ComputeBoardDerivatives(b);
-		level_derivs_[level].PushAll(derivs);
+        unique_ptr<Board> c(new Board(b));
+        PushDerivatives(*c, level);
 	}
 
-    vector<Derivative_> ComputeBoardDerivatives(Board b) {
+    // parent goes to the pool of the level only if some derivative is found.
+    // children are discovered without the lock, parent and children are pushed under it
+    bool PushDerivatives(Board& b, int level) {
         vector<Derivative_> res;
-        auto b_ptr = make_shared<Board>(b);
         b.ForEachAppliedCast([&](CastType cast){
             // if cast is empty, board has to be discovered
             if (discovery_.Discover(b)) {
-                Derivative_ st(b_ptr, cast, score_(b), b.hash());
+                Derivative_ st(0, cast, score_(b), b.hash());
                 res.push_back(st);
             }
             // somewhere we have to check if it's finish and if yes we should reduce number of levels
         });
-        return res;
+        if (res.empty()) return false;
+        lock_guard<mutex> lock(level_sync_[level].lock);
+        auto parent = level_derivs_[level].AddParent(b);
+        for (auto& d : res) d.parent = parent;
+        return level_derivs_[level].PushAll(res);
     }
-	
+
 	int ProminentLevel() {
 		auto func = [](ScoreStats& ss) {
 			return (ss.best - ss.min) / (ss.max - ss.min);
 		};
-		int i = MaxElement(level_score_stats_.begin(), level_score_stats_.end(), func) - level_score_stats_.begin();
+		lock_guard<mutex> lock(solution_lock_);
+		auto begin = level_score_stats_.begin();
+		int i = MaxElement(begin, begin + level_count_, func) - begin;
         return i;
 	}
-	
+
 	struct ScoreStats {
 		double min;
 		double max;
@@ -183,12 +321,24 @@ private:
 
 	// after we do the cast we come to the level
     vector<LevelDerivatives_> level_derivs_;
+    vector<LevelSync> level_sync_;
     vector<ScoreStats> level_score_stats_;
     vector<Count> level_derivs_used_;
+    atomic<int> level_count_{0};
 	int promotion_count_;
     DiscoveryNew discovery_;
+    mutex solution_lock_;
 	Board solution_;
 	Board original_;
 	ScoreType score_;
     Count millis_{30000};
+    Count node_budget_{0};
+    atomic<Count> nodes_{0};
+    // nodes_ at the last collect of history
+    Count collected_nodes_{0};
+    Count collect_period_{kMinCollectPeriod};
+    atomic<bool> history_full_{false};
+    shared_ptr<WorkerPool> pool_;
+
+    constexpr static Count kMinCollectPeriod = 1 << 12;
 };
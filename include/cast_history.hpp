@@ -3,6 +3,9 @@
 //
 #pragma once
 
+#include <atomic>
+#include <mutex>
+
 #include "util.hpp"
 
 class CastHistory {
@@ -68,6 +71,117 @@ private:
     friend vector<Position> ToVector(const CastHistory_Nodes& history);
 };
 
+// nodes of all boards descending from one detached board, addressed by 32 bit index.
+// nodes are never freed one by one: Collect marks nodes reachable from live
+// histories with new epoch and everything else is reused by next pushes.
+// Allocate can be called from many threads, Collect only when nobody pushes.
+// engines that never collect (Greedy, NaiveSearch, BeamSearchNew with the pool)
+// keep every node till the arena goes away with the last board of the search
+template<class Data>
+class HistoryArena {
+public:
+    using NodeIndex = uint32_t;
+
+    constexpr static NodeIndex kNil = numeric_limits<NodeIndex>::max();
+
+    struct Node {
+        Data value;
+        NodeIndex previous;
+        uint32_t epoch;
+    };
+
+    HistoryArena() {
+        for (auto& c : chunks_) c.store(nullptr, memory_order_relaxed);
+    }
+
+    HistoryArena(const HistoryArena&) = delete;
+    HistoryArena& operator=(const HistoryArena&) = delete;
+
+    ~HistoryArena() {
+        for (auto& c : chunks_) delete[] c.load(memory_order_relaxed);
+    }
+
+    NodeIndex Allocate(const Data& value, NodeIndex previous) {
+        auto f = free_cursor_.fetch_add(1, memory_order_relaxed);
+        NodeIndex i = f < free_.size() ? free_[f] : size_.fetch_add(1, memory_order_relaxed);
+        // table never grows, release build would write past it
+        if (i >= kChunkCount * kChunkSize) throw length_error("history arena is full");
+        Chunk(i >> kChunkShift)[i & kChunkMask] = {value, previous, epoch_};
+        return i;
+    }
+
+    const Node& operator[](NodeIndex i) const {
+        return chunks_[i >> kChunkShift].load(memory_order_acquire)[i & kChunkMask];
+    }
+
+    void StartEpoch() {
+        ++epoch_;
+    }
+
+    // marks node and all its ancestors, stops on already marked ones
+    void Mark(NodeIndex i) {
+        while (i != kNil) {
+            auto& n = node(i);
+            if (n.epoch == epoch_) break;
+            n.epoch = epoch_;
+            i = n.previous;
+        }
+    }
+
+    void FinishEpoch() {
+        free_.clear();
+        NodeIndex sz = size();
+        for (NodeIndex i = 0; i < sz; ++i) {
+            if (node(i).epoch != epoch_) free_.push_back(i);
+        }
+        free_cursor_.store(0, memory_order_relaxed);
+    }
+
+    // nodes ever allocated, both live and free
+    Count size() const {
+        return size_.load(memory_order_relaxed);
+    }
+
+    Count free_count() const {
+        auto f = free_cursor_.load(memory_order_relaxed);
+        return f < free_.size() ? free_.size() - f : 0;
+    }
+
+private:
+    constexpr static Count kChunkShift = 14;
+    constexpr static Count kChunkSize = 1 << kChunkShift;
+    constexpr static Count kChunkMask = kChunkSize - 1;
+    constexpr static Count kChunkCount = 1 << 12;
+
+    Node& node(NodeIndex i) {
+        return chunks_[i >> kChunkShift].load(memory_order_relaxed)[i & kChunkMask];
+    }
+
+    Node* Chunk(Index c) {
+        auto p = chunks_[c].load(memory_order_acquire);
+        if (p != nullptr) return p;
+        lock_guard<mutex> lock(chunk_mutex_);
+        p = chunks_[c].load(memory_order_relaxed);
+        if (p == nullptr) {
+            p = new Node[kChunkSize];
+            chunks_[c].store(p, memory_order_release);
+        }
+        return p;
+    }
+
+    // table never grows, so readers don't need a lock
+    array<atomic<Node*>, kChunkCount> chunks_;
+    mutex chunk_mutex_;
+    atomic<NodeIndex> size_{0};
+    // indices of unreachable nodes found by last collect
+    vector<NodeIndex> free_;
+    atomic<size_t> free_cursor_{0};
+    uint32_t epoch_{0};
+};
+
+
+// copies of a board share the arena, history itself is index of the last cast.
+// arena is created by first push
 class CastHistory_Nodes_v2 {
 
     struct Data {
@@ -75,18 +189,29 @@ class CastHistory_Nodes_v2 {
         short ray_index;
     };
 
-    using Node = TrailNode<Data>;
-    using NodePtr = TrailNodePtr<Data>;
+    using Arena = HistoryArena<Data>;
+    using NodeIndex = Arena::NodeIndex;
 
 public:
+    CastHistory_Nodes_v2() = default;
+    CastHistory_Nodes_v2(const CastHistory_Nodes_v2&) = default;
+
+    // arena pointer is reassigned only when it differs to keep ref count untouched
+    CastHistory_Nodes_v2& operator=(const CastHistory_Nodes_v2& h) {
+        if (arena_ != h.arena_) arena_ = h.arena_;
+        history_ = h.history_;
+        count_ = h.count_;
+        return *this;
+    }
+
     void Pop() {
-        history_ = history_->previous;
+        history_ = (*arena_)[history_].previous;
         --count_;
     }
 
     void Push(const Position&p, short ray_index) {
-        Node *new_node = new Node(Data{p, ray_index}, history_);
-        history_.reset(new_node);
+        if (!arena_) arena_ = make_shared<Arena>();
+        history_ = arena_->Allocate(Data{p, ray_index}, history_);
         ++count_;
     }
 
@@ -94,7 +219,47 @@ public:
         return count_;
     }
 
-    NodePtr history_;
+    // moves history into new arena, so collecting it
+    // doesn't touch boards that shared the old one
+    void Detach() {
+        vector<Data> data;
+        ForEach([&](const Data& d) { data.push_back(d); });
+        arena_ = make_shared<Arena>();
+        history_ = Arena::kNil;
+        for (auto it = data.rbegin(); it != data.rend(); ++it) {
+            history_ = arena_->Allocate(*it, history_);
+        }
+    }
+
+    // nodes not reachable from histories of given items become free.
+    // every item has to share one arena
+    template<class Items, class Get>
+    static void Collect(const Items& items, Get get) {
+        shared_ptr<Arena> arena;
+        for (auto& it : items) {
+            auto& h = get(it);
+            if (!h.arena_) continue;
+            if (!arena) {
+                arena = h.arena_;
+                arena->StartEpoch();
+            }
+            assert(arena == h.arena_);
+            arena->Mark(h.history_);
+        }
+        if (arena) arena->FinishEpoch();
+    }
+
+private:
+    // from last cast to first
+    template<class Func>
+    void ForEach(Func func) const {
+        for (auto i = history_; i != Arena::kNil; i = (*arena_)[i].previous) {
+            func((*arena_)[i].value);
+        }
+    }
+
+    shared_ptr<Arena> arena_;
+    NodeIndex history_{Arena::kNil};
     ::Count count_{0};
 
     friend vector<Position> ToVector(const CastHistory_Nodes_v2& history);
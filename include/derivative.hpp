@@ -5,22 +5,76 @@
 
 #include "util.hpp"
 #include "board.hpp"
+#include "top_k.hpp"
 
 
+// parents of one level. derivatives keep index of the slot,
+// slot is reused when no derivative of the parent is left
+template <class Board>
+class ParentPool {
+public:
+    Index Add(const Board& b) {
+        Index i;
+        if (free_.empty()) {
+            i = boards_.size();
+            boards_.push_back(b);
+            refs_.push_back(0);
+        } else {
+            i = free_.back();
+            free_.pop_back();
+            boards_[i] = b;
+        }
+        return i;
+    }
+
+    const Board& operator[](Index i) const {
+        return boards_[i];
+    }
+
+    void AddRef(Index i) {
+        ++refs_[i];
+    }
+
+    void Release(Index i) {
+        if (--refs_[i] == 0) free_.push_back(i);
+    }
+
+    template<class Func>
+    void ForEach(Func func) const {
+        for (Index i = 0; i < boards_.size(); ++i) {
+            if (refs_[i] > 0) func(boards_[i]);
+        }
+    }
+
+    // parents that still have derivatives
+    Count size() const {
+        return boards_.size() - free_.size();
+    }
+
+private:
+    vector<Board> boards_;
+    vector<Count> refs_;
+    vector<Index> free_;
+};
+
+
+// board is not kept, it's the parent cast with cast
 template <class Board>
 struct Derivative {
 
+    using BoardType = Board;
     using CastType = typename Board::CastType;
     using HashType = typename Board::HashType;
 
-    shared_ptr<const Board> board;
+    // slot in ParentPool of the level
+    Index parent;
     CastType cast;
     double score;
     HashType hash;
 
     Derivative() {}
-    Derivative(shared_ptr<const Board> board, CastType cast, double score, HashType hash)
-            : board(board), cast(cast), score(score), hash(hash) {}
+    Derivative(Index parent, CastType cast, double score, HashType hash)
+            : parent(parent), cast(cast), score(score), hash(hash) {}
 
     bool operator<(const Derivative& s) const {
         return score < s.score;
@@ -32,60 +86,128 @@ struct Derivative {
 };
 
 
-// it's a little bit different
+// it's a little bit different.
+// keeps parents of its derivatives, a board is made only for promoted ones.
+// best derivatives, as many as last promotion took, are streamed into bounded heap
+// while pushed, everything displaced from it is in rest_. so promotion of the
+// same size is the heap as is, rest_ is ranked only to fill the heap back
 template <class Derivative>
 struct LevelDerivatives {
 
+    using Board = typename Derivative::BoardType;
+
     // later can make method with another argument, like functor
-    // at some point we have to shrink most certainly
+    // at some point we have to shrink most certainly.
+    // parents of result stay until Release
     vector<Derivative> ExtractPromotion(int count) {
-        auto sz = min<Count>(count, derivs_.size());
-        nth_element(derivs_.begin(), derivs_.begin()+sz-1, derivs_.end(), std::greater<Derivative>());
-        vector<Derivative> res(derivs_.begin(), derivs_.begin()+sz);
-        derivs_.erase(derivs_.begin(), derivs_.begin()+sz);
+        if (count != best_.capacity()) {
+            auto& items = best_.items();
+            rest_.insert(rest_.end(), items.begin(), items.end());
+            best_.clear();
+            best_.set_capacity(count);
+            Refill();
+        }
+        auto res = best_.Extract();
+        Refill();
         return res;
     }
 
+    Index AddParent(const Board& b) {
+        return parents_.Add(b);
+    }
+
+    // derivative is this board with d.cast applied
+    const Board& parent(const Derivative& d) const {
+        return parents_[d.parent];
+    }
+
+    void Release(const vector<Derivative>& derivs) {
+        for (auto& d : derivs) parents_.Release(d.parent);
+    }
+
     void Insert(const Derivative& d) {
-        derivs_.push_back(d);
+        parents_.AddRef(d.parent);
+        Derivative displaced;
+        bool was_full = best_.full();
+        if (!best_.Push(d, &displaced)) {
+            rest_.push_back(d);
+        } else if (was_full) {
+            rest_.push_back(displaced);
+        }
     }
 
+    // search goes on to the next level whatever got into the heap
     bool PushAll(const vector<Derivative>& derivs) {
-        derivs_.insert(derivs_.end(), derivs.begin(), derivs.end());
+        for (auto& d : derivs) Insert(d);
         return true;
     }
 
+    // heap has the best, worst of rest_ are dropped
     void Cap() {
-        if (derivs_.size() > cap_) {
-            nth_element(derivs_.begin(), derivs_.begin()+cap_-1, derivs_.end(), std::greater<Derivative>());
-            derivs_.erase(derivs_.begin()+cap_, derivs_.end());
+        Count rest_cap = max<Count>(0, cap_ - best_.size());
+        if (rest_.size() > rest_cap) {
+            top_k_.Split(rest_, rest_cap, Score);
+            for (auto it = rest_.begin()+rest_cap; it != rest_.end(); ++it) parents_.Release(it->parent);
+            rest_.erase(rest_.begin()+rest_cap, rest_.end());
         }
     }
 
     Count derivatives_left() const {
-        return derivs_.size();
+        return best_.size() + rest_.size();
+    }
+
+    void clear() {
+        best_ = BoundedHeap<Derivative>(best_.capacity());
+        rest_.clear();
+        rest_.shrink_to_fit();
+        parents_ = ParentPool<Board>();
+    }
+
+    Count parents_left() const {
+        return parents_.size();
+    }
+
+    // parents that still have derivatives
+    template<class Func>
+    void ForEachParent(Func func) const {
+        parents_.ForEach(func);
     }
 
 private:
-    vector<Derivative> derivs_;
+    static double Score(const Derivative& d) {
+        return d.score;
+    }
+
+    // heap takes best of rest_ while it has room
+    void Refill() {
+        auto sz = min<Count>(best_.capacity() - best_.size(), rest_.size());
+        if (sz <= 0) return;
+        top_k_.Split(rest_, sz, Score);
+        for (auto it = rest_.begin(); it != rest_.begin()+sz; ++it) best_.Push(*it);
+        rest_.erase(rest_.begin(), rest_.begin()+sz);
+    }
+
+    BoundedHeap<Derivative> best_;
+    vector<Derivative> rest_;
+    TopK<Derivative> top_k_;
+    ParentPool<Board> parents_;
     int cap_{20000};
 };
 
 
-// elements with highest score go first
+// best promotion_count_ elements are kept in bounded heap while pushed
 template <class Derivative>
 struct LevelDerivativesNew {
 
     // later can make method with another argument, like functor
     // at some point we have to shrink most certainly
     vector<Derivative> ExtractPromotion(int count) {
-        auto res = best_;
-        best_.clear();
+        auto res = best_.Extract();
 
         auto sz = min<Count>(promotion_count_, rest_.size());
-        nth_element(rest_.begin(), rest_.begin()+sz-1, rest_.end(), std::greater<Derivative>());
-        best_.insert(best_.begin(), rest_.begin(), rest_.begin()+sz);
-        sort(best_.begin(), best_.end(), std::greater<Derivative>());
+        top_k_.Split(rest_, sz, Score);
+        best_.set_capacity(promotion_count_);
+        for (auto it = rest_.begin(); it != rest_.begin()+sz; ++it) best_.Push(*it);
         rest_.erase(rest_.begin(), rest_.begin()+sz);
 
         return res;
@@ -94,31 +216,23 @@ struct LevelDerivativesNew {
     // we consider that if best is empty rest is also should be empty
     bool PushAll(vector<Derivative>& derivs) {
         bool best_updated = false;
-        if (best_.size() < promotion_count_) {
-            auto sz = min(promotion_count_-best_.size(), derivs.size());
-            if (sz > 0) best_updated = true;
-            best_.insert(best_.end(), derivs.begin()+derivs.size()-sz, derivs.end());
-            derivs.erase(derivs.begin()+derivs.size()-sz, derivs.end());
-            sort(best_.begin(), best_.end(), std::greater<Derivative>());
-        }
+        best_.set_capacity(promotion_count_);
+        Derivative displaced;
         for (auto& d : derivs) {
-            if (best_.back().score < d.score) {
+            bool was_full = best_.full();
+            if (best_.Push(d, &displaced)) {
                 best_updated = true;
-                auto b = best_.back();
-                best_.pop_back();
-                best_.insert(upper_bound(best_.begin(), best_.end(), d, std::greater<Derivative>()), d);
-                d = b;
+                if (was_full) rest_.push_back(displaced);
+            } else {
+                rest_.push_back(d);
             }
         }
-        rest_.insert(rest_.end(), derivs.begin(), derivs.end());
-
         return best_updated;
     }
 
     void Cap() {
         if (rest_.size() > cap_) {
-            nth_element(rest_.begin(), rest_.begin()+cap_-1, rest_.end(), std::greater<Derivative>());
-            rest_.erase(rest_.begin()+cap_, rest_.end());
+            top_k_.Select(rest_, cap_, Score);
         }
     }
 
@@ -128,13 +242,14 @@ struct LevelDerivativesNew {
 
 private:
 
-    void ReplenishBest() {
-
+    static double Score(const Derivative& d) {
+        return d.score;
     }
 
     int promotion_count_{100};
     int cap_{20000};
-    vector<Derivative> best_;
+    BoundedHeap<Derivative> best_;
     vector<Derivative> rest_;
+    TopK<Derivative> top_k_;
 };
 
@@ -11,6 +11,7 @@
 #include "board_v1_impl_1.hpp"
 #include "cast_history.hpp"
 #include "score.hpp"
+#include "naive_search.hpp"
 
 
 class DFS {
@@ -39,11 +40,14 @@ public:
 
         auto minCastCount = numeric_limits<int>::max();
         auto res = board;
+        // deepest dive that got stuck, finished greedily if nothing else is found
+        auto partial = board;
 
         auto startMillisCount = GetMillisCount();
 
+        nodes_ = 0;
         // dfs
-        while (GetMillisCount() - startMillisCount < millis_timeout_) {
+        while (GetMillisCount() - startMillisCount < millis_timeout_ && (node_budget_ == 0 || nodes_ < node_budget_)) {
 
             Board b;
             if (queue_.empty()) {
@@ -63,8 +67,15 @@ public:
 
             if (b.AllDestroyed() && b.CastCount() < minCastCount) {
                 res = b;
+                minCastCount = b.CastCount();
+            } else if (!b.AllDestroyed() && b.MirrorsDestroyed() > partial.MirrorsDestroyed()) {
+                partial = b;
             }
         }
+        if (!res.AllDestroyed()) {
+            Score_v1 s;
+            res = NaiveSearch<Board, Score_v1>().Destroy(partial, s);
+        }
         return res;
     }
 
@@ -80,10 +91,21 @@ public:
         queue_cap_ = cap;
     }
 
+    // search also stops after that many expanded boards, 0 is no limit
+    void set_node_budget(Count node_budget) {
+        node_budget_ = node_budget;
+    }
+
+    // boards expanded by last Destroy
+    Count nodes() const {
+        return nodes_;
+    }
+
 private:
 
     experimental::optional<Position> IntroduceDerivatives(Board& b) {
         assert(!b.AllDestroyed());
+        ++nodes_;
         auto b_ptr = make_shared<Board>(b);
         State best;
         best.score = numeric_limits<double>::min();
@@ -130,6 +152,8 @@ private:
 
     // by default queue is max
     unsigned millis_timeout_ = 10000;
+    Count node_budget_ = 0;
+    Count nodes_ = 0;
     Score score_;
 
     multiset<State> queue_;
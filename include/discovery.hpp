@@ -3,13 +3,16 @@
 //
 #pragma once
 
+#include <mutex>
+
 #include "util.hpp"
 #include "board.hpp"
 
 
 struct Discovery {
 
-    bool Discover(const Board& b) {
+    template<class B>
+    bool Discover(const B& b) {
         return discovered_.insert(b.hash()).second;
     }
 
@@ -18,20 +21,85 @@ private:
     unordered_set<Board::HashType> discovered_;
 };
 
-struct DiscoveryNew {
+// keeps least cast count of discovered hashes in fixed memory.
+// table is split into buckets of one cache line, hash that doesn't fit
+// evicts another one of its bucket by clock: every hit marks the entry,
+// hand clears marks until it finds unmarked one.
+// evicted board can be discovered again, that costs a duplicate only.
+// can be used by several threads, buckets are guarded by striped locks
+class DiscoveryNew {
 
-    bool Discover(const Board& b) {
-        auto it = discovered_.find(b.hash());
-        if (it == discovered_.end() || it->second > b.CastCount()) {
-            discovered_[b.hash()] = b.CastCount();
-            return true;
+    // 5 keys with their counts and marks fill the line
+    static constexpr Count kWays = 5;
+    static constexpr Count kLockCount = 64;
+
+    struct alignas(64) Bucket {
+        uint64_t keys[kWays];
+        uint16_t counts[kWays];
+        uint8_t marks[kWays];
+        uint8_t hand;
+    };
+
+public:
+    static constexpr size_t kDefaultMemory = 64 << 20;
+
+    explicit DiscoveryNew(size_t memory = kDefaultMemory) {
+        set_memory(memory);
+    }
+
+    // rounded down to power of two buckets, at least one. clears the table
+    void set_memory(size_t memory) {
+        bucket_bits_ = 0;
+        while ((sizeof(Bucket) << (bucket_bits_+1)) <= memory) ++bucket_bits_;
+        buckets_.assign(size_t(1) << bucket_bits_, Bucket{});
+    }
+
+    size_t memory() const {
+        return buckets_.size() * sizeof(Bucket);
+    }
+
+    template<class B>
+    bool Discover(const B& b) {
+        uint64_t key = b.hash().to_ullong();
+        // zero marks empty entry
+        if (key == 0) key = 1;
+        uint16_t cast_count = b.CastCount();
+        auto index = bucket_bits_ == 0 ? 0 : key >> (64 - bucket_bits_);
+        lock_guard<mutex> lock(locks_[index % kLockCount]);
+        auto& bucket = buckets_[index];
+        for (auto i = 0; i < kWays; ++i) {
+            if (bucket.keys[i] != key) continue;
+            bucket.marks[i] = 1;
+            if (bucket.counts[i] > cast_count) {
+                bucket.counts[i] = cast_count;
+                return true;
+            }
+            return false;
         }
-        return false;
+        Index i = 0;
+        while (i < kWays && bucket.keys[i] != 0) ++i;
+        if (i == kWays) {
+            while (bucket.marks[bucket.hand]) {
+                bucket.marks[bucket.hand] = 0;
+                bucket.hand = (bucket.hand + 1) % kWays;
+            }
+            i = bucket.hand;
+            bucket.hand = (i + 1) % kWays;
+        }
+        bucket.keys[i] = key;
+        bucket.counts[i] = cast_count;
+        bucket.marks[i] = 1;
+        return true;
+    }
+
+    void clear() {
+        fill(buckets_.begin(), buckets_.end(), Bucket{});
     }
 
 private:
-    // look for less count of cast on discover
-    unordered_map<Board::HashType, Count> discovered_;
+    vector<Bucket> buckets_;
+    Count bucket_bits_;
+    array<mutex, kLockCount> locks_;
 };
 
 
@@ -43,7 +111,8 @@ struct DiscoveryFast {
         discovered_.resize(2 << BIT_COUNT, 0);
     }
 
-    bool Discover(const Board& b) {
+    template<class B>
+    bool Discover(const B& b) {
         auto index = ((uint32_t)b.hash().to_ulong() << (32-BIT_COUNT)) >> (32-BIT_COUNT);
         if (discovered_[index] == 0 || discovered_[index] > b.CastCount()) {
             discovered_[index] = b.CastCount();
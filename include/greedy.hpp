@@ -10,6 +10,7 @@
 #define FRAGILE_MIRRORS_greedy_hpp
 
 #include "util.hpp"
+#include "board.hpp"
 
 using namespace std;
 using namespace ant;
@@ -19,6 +20,7 @@ using namespace ant::grid;
 
 template<class Board>
 struct Greedy {
+    static_assert(IsStaticBoard<Board>::value, "board calls would be virtual");
 
     struct Derivative {
         Derivative() {}
@@ -39,14 +41,15 @@ struct Greedy {
     };
     
     
-    // need to pass in score function
+    // need to pass in score function.
+    // one board is cast in place, every history node stays live
     using Func = function<double(const Board& b)>;
     Board Destroy(const Board& b, const Func& func) {
         Board board = b;
         while (!board.AllDestroyed()) {
             if (board.EmptySpace() > 0.5 * board.FilledSpace()) board.Reduce();
             double best_score = numeric_limits<double>::max();
-            short best_ray;
+            short best_ray = 0;
             for (int ray = 0; ray < board.RayCount(); ++ray) {
                 board.CastRestorable(ray);
                 double score = func(board);
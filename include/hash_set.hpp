@@ -0,0 +1,176 @@
+//
+// Created by Anton Logunov on 5/4/17.
+//
+#pragma once
+
+#include <atomic>
+#include <bitset>
+
+#include "util.hpp"
+
+
+// open addressing set of 64 bit keys that is cleared and refilled on every beam layer.
+// each slot keeps generation it was filled on, so clear only increments the generation.
+// capacity is power of two, load factor is kept under 1/2
+class LayerHashSet {
+
+    struct Slot {
+        // generation << 1 while key is written, (generation << 1) | 1 when key is ready
+        atomic<uint32_t> stamp{0};
+        uint64_t key;
+    };
+
+public:
+    LayerHashSet() {
+        Allocate(kMinCapacity);
+    }
+
+    LayerHashSet(const LayerHashSet& s) {
+        *this = s;
+    }
+
+    LayerHashSet& operator=(const LayerHashSet& s) {
+        if (this == &s) return *this;
+        Allocate(s.capacity_);
+        for (auto i = 0; i < capacity_; ++i) {
+            slots_[i].stamp.store(s.slots_[i].stamp.load(memory_order_relaxed), memory_order_relaxed);
+            slots_[i].key = s.slots_[i].key;
+        }
+        generation_ = s.generation_;
+        size_ = s.size();
+        return *this;
+    }
+
+    // makes sure count keys fit without growing, clears the set
+    void reserve(Count count) {
+        auto capacity = kMinCapacity;
+        while (capacity < 2*count) capacity <<= 1;
+        if (capacity > capacity_) {
+            Allocate(capacity);
+        } else {
+            clear();
+        }
+    }
+
+    void clear() {
+        if (++generation_ == kMaxGeneration) {
+            for (auto i = 0; i < capacity_; ++i) slots_[i].stamp.store(0, memory_order_relaxed);
+            generation_ = 1;
+        }
+        size_ = 0;
+        size_concurrent_.store(0, memory_order_relaxed);
+    }
+
+    // returns true if key was not there
+    bool insert(uint64_t key) {
+        if (2*(size()+1) > capacity_) Grow();
+        auto ready = Ready();
+        for (auto i = Home(key);; i = (i+1) & mask_) {
+            auto& s = slots_[i];
+            auto stamp = s.stamp.load(memory_order_relaxed);
+            if (stamp != ready) {
+                s.key = key;
+                s.stamp.store(ready, memory_order_relaxed);
+                ++size_;
+                return true;
+            }
+            if (s.key == key) return false;
+        }
+    }
+
+    // can be called by many threads at the same time, but not along with other methods.
+    // set never grows here, reserve has to be called beforehand
+    bool insert_concurrent(uint64_t key) {
+        auto ready = Ready();
+        auto busy = ready ^ 1;
+        for (auto i = Home(key);; i = (i+1) & mask_) {
+            auto& s = slots_[i];
+            auto stamp = s.stamp.load(memory_order_acquire);
+            while (stamp < busy) {
+                // slot is from previous generation, try to take it
+                if (s.stamp.compare_exchange_weak(stamp, busy, memory_order_acquire)) {
+                    s.key = key;
+                    s.stamp.store(ready, memory_order_release);
+                    size_concurrent_.fetch_add(1, memory_order_relaxed);
+                    return true;
+                }
+            }
+            while (stamp == busy) {
+                stamp = s.stamp.load(memory_order_acquire);
+            }
+            if (s.key == key) return false;
+        }
+    }
+
+    bool count(uint64_t key) const {
+        auto ready = Ready();
+        for (auto i = Home(key);; i = (i+1) & mask_) {
+            auto& s = slots_[i];
+            if (s.stamp.load(memory_order_relaxed) != ready) return false;
+            if (s.key == key) return true;
+        }
+    }
+
+    bool insert(const bitset<64>& key) {
+        return insert(key.to_ullong());
+    }
+
+    bool insert_concurrent(const bitset<64>& key) {
+        return insert_concurrent(key.to_ullong());
+    }
+
+    bool count(const bitset<64>& key) const {
+        return count(key.to_ullong());
+    }
+
+    Count size() const {
+        return size_ + size_concurrent_.load(memory_order_relaxed);
+    }
+
+    Count capacity() const {
+        return capacity_;
+    }
+
+private:
+    constexpr static Count kMinCapacity = 1 << 10;
+    constexpr static uint32_t kMaxGeneration = 1u << 31;
+
+    uint32_t Ready() const {
+        return (generation_ << 1) | 1;
+    }
+
+    // zobrist hashes are random already, multiplication spreads other keys
+    Index Home(uint64_t key) const {
+        return (key * 0x9E3779B97F4A7C15ull) >> shift_;
+    }
+
+    void Allocate(Count capacity) {
+        slots_.reset(new Slot[capacity]);
+        capacity_ = capacity;
+        mask_ = capacity - 1;
+        shift_ = 64;
+        while ((Count(1) << (64 - shift_)) < capacity) --shift_;
+        generation_ = 1;
+        size_ = 0;
+        size_concurrent_.store(0, memory_order_relaxed);
+    }
+
+    void Grow() {
+        auto ready = Ready();
+        vector<uint64_t> keys;
+        keys.reserve(size());
+        for (auto i = 0; i < capacity_; ++i) {
+            if (slots_[i].stamp.load(memory_order_relaxed) == ready) keys.push_back(slots_[i].key);
+        }
+        Allocate(2*capacity_);
+        for (auto k : keys) insert(k);
+    }
+
+    unique_ptr<Slot[]> slots_;
+    Count capacity_;
+    Index mask_;
+    int shift_;
+    uint32_t generation_;
+    Count size_;
+    atomic<Count> size_concurrent_{0};
+};
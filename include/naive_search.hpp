@@ -9,29 +9,42 @@
 #ifndef FragileMirrors_naive_search_hpp
 #define FragileMirrors_naive_search_hpp
 
+#include "board.hpp"
+
 
 /// Score is a function or object with call operator, 
 /// that receives one board argument and returns double that determines
-/// how good the board is, the bigger the better 
+/// how good the board is, the bigger the better.
+/// one board is cast in place, every history node stays live
 template<class Board, class Score>
 class NaiveSearch {
+    static_assert(IsStaticBoard<Board>::value, "board calls would be virtual");
     
     using C = typename Board::CastType;
 
 public:
     Board Destroy(const Board& b_in, Score& s) {
         Board bb(b_in);
-        C best_cast{};
-        double score, best_score = numeric_limits<double>::min();
         while (!bb.AllDestroyed()) {
+            bb.ReduceIfWorth();
+            // scores of one step are compared only to each other: lookahead
+            // can score a child below the best child of the step before.
+            // casts that destroy nothing would never finish
+            C best_cast{};
+            bool chosen = false;
+            double score, best_score = numeric_limits<double>::lowest();
+            Count destroyed = bb.MirrorsDestroyed();
             auto func = [&](auto cast) {
+                if (bb.MirrorsDestroyed() == destroyed) return;
                 score = s(bb);
                 if (score > best_score) {
                     best_cast = cast;
                     best_score = score;
+                    chosen = true;
                 }
             };
             bb.ForEachAppliedCast(func);
+            if (!chosen) throw runtime_error("naive search: no cast destroys a mirror");
             bb.Cast(best_cast);
         }
         return bb;
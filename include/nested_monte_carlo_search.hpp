@@ -69,6 +69,7 @@ public:
             int minCount = numeric_limits<int>::max();
             for (auto p : b.CastCandidates()) {
                 if (b.Cast(p) > 0) {
+                    ++playouts_;
                     Count castCount = RandomPlayout(b);
                     if (minCount > castCount) {
                         minCount = castCount;
@@ -85,6 +86,14 @@ public:
         return b_uni;
     }
 
+    // random playouts made since construction
+    Count playouts() const {
+        return playouts_;
+    }
+
+private:
+    Count playouts_ = 0;
+
 };
 
 
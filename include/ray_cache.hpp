@@ -0,0 +1,131 @@
+//
+// Created by Anton Logunov on 5/30/17.
+//
+#pragma once
+
+#include "util.hpp"
+
+
+// result of restorable cast of every ray for a board that is cast in place.
+// ray is put on lists of items it touches: border it starts from and mirrors
+// it destroys. when an item is destroyed or restored, board drops rays on lists
+// of the item and of its neighbours: only those rays can go another way now,
+// or take the last mirrors of one line more or less.
+// cache is about the board it was built on, copies start without it
+class RayCache {
+
+    struct Ref {
+        short ray;
+        uint32_t version;
+    };
+
+public:
+    struct Entry {
+        uint64_t hash;
+        short count;
+        char empty_rows;
+        char empty_cols;
+    };
+
+    RayCache() {}
+
+    RayCache(const RayCache&) {}
+
+    RayCache& operator=(const RayCache&) {
+        Disable();
+        return *this;
+    }
+
+    // every ray is missing after reset
+    void Reset(Count ray_count, Count item_count) {
+        enabled_ = true;
+        entries_.resize(ray_count);
+        valid_.assign(ray_count, false);
+        versions_.resize(ray_count, 0);
+        lists_.resize(item_count);
+        for (auto& list : lists_) list.clear();
+        limits_.assign(item_count, kPruneMinSize);
+    }
+
+    void Disable() {
+        enabled_ = false;
+        entries_.clear();
+        valid_.clear();
+        versions_.clear();
+        lists_.clear();
+        limits_.clear();
+    }
+
+    bool enabled() const {
+        return enabled_;
+    }
+
+    bool valid(Index ray) const {
+        return valid_[ray];
+    }
+
+    const Entry& operator[](Index ray) const {
+        return entries_[ray];
+    }
+
+    // items are mirrors destroyed by the ray, border of the ray is ray index
+    template<class It>
+    void Record(short ray, const Entry& e, It items_begin, It items_end) {
+        entries_[ray] = e;
+        valid_[ray] = true;
+        Ref ref{ray, ++versions_[ray]};
+        Push(ray, ref);
+        for (auto it = items_begin; it != items_end; ++it) {
+            Push(*it, ref);
+        }
+    }
+
+    // refs on all lists, stale ones included
+    size_t ref_count() const {
+        size_t res = 0;
+        for (auto& list : lists_) res += list.size();
+        return res;
+    }
+
+    size_t live_ref_count() const {
+        size_t res = 0;
+        for (auto& list : lists_) res += count_if(list.begin(), list.end(), [&](const Ref& r) { return live(r); });
+        return res;
+    }
+
+    // stale refs are skipped
+    void Drop(short item) {
+        auto& list = lists_[item];
+        for (auto& r : list) {
+            if (live(r)) valid_[r.ray] = false;
+        }
+        list.clear();
+        limits_[item] = kPruneMinSize;
+    }
+
+private:
+    bool live(const Ref& r) const {
+        return valid_[r.ray] && versions_[r.ray] == r.version;
+    }
+
+    // refs of rays recorded again or dropped through another item are stale.
+    // list is pruned when it reaches its limit, then limit is twice of what's
+    // left, so pruning is paid by pushes before it
+    void Push(short item, const Ref& r) {
+        auto& list = lists_[item];
+        if (list.size() >= limits_[item]) {
+            list.erase(remove_if(list.begin(), list.end(), [&](const Ref& r) { return !live(r); }), list.end());
+            limits_[item] = max<size_t>(kPruneMinSize, 2 * list.size());
+        }
+        list.push_back(r);
+    }
+
+    constexpr static size_t kPruneMinSize = 8;
+
+    bool enabled_{false};
+    vector<Entry> entries_;
+    vector<char> valid_;
+    vector<uint32_t> versions_;
+    vector<vector<Ref>> lists_;
+    vector<size_t> limits_;
+};
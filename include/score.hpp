@@ -18,6 +18,41 @@ using namespace std;
 
 extern const array<double, 51> EMPTY_LINES_PARAM;
 
+inline double EmptyLinesParam(Count board_size) {
+    return EMPTY_LINES_PARAM[min<Count>(max<Count>(board_size, 50), 100) - 50];
+}
+
+// fixed point score, kScoreOne stands for one destroyed mirror.
+// board of size 100 stays far below int32 limit
+using IntScore = int32_t;
+constexpr IntScore kScoreOne = 1 << 12;
+
+inline IntScore EmptyLinesParamInt(Count board_size) {
+    return lround(EmptyLinesParam(board_size) * kScoreOne);
+}
+
+
+// boards that keep Score_v1 up to date while casting provide ScoreValue_v1
+template<class B, class = void>
+struct HasScoreValue_v1 : false_type {};
+
+template<class B>
+struct HasScoreValue_v1<B, void_t<decltype(declval<const B&>().ScoreValue_v1())>> : true_type {};
+
+template<class B, class = void>
+struct HasScoreValue_v1_Int : false_type {};
+
+template<class B>
+struct HasScoreValue_v1_Int<B, void_t<decltype(declval<const B&>().ScoreValue_v1_Int())>> : true_type {};
+
+// scores that read only counters and hash of the board declare CountersOnly.
+// those can be given children made by shifting counters, links stay the parent's
+template<class S, class = void>
+struct IsCountersOnlyScore : false_type {};
+
+template<class S>
+struct IsCountersOnlyScore<S, void_t<typename S::CountersOnly>> : S::CountersOnly {};
+
 
 class Score {
 public:
@@ -25,23 +60,92 @@ public:
         return b.MirrorsDestroyed();
     }
 
+    // static boards are not Board, they come here
+    template<class B>
+    double operator()(const B& b) const {
+        return b.MirrorsDestroyed();
+    }
+
     virtual ~Score() {}
 };
 
 
 class Score_v1 : public Score {
 public:
+    using CountersOnly = true_type;
+
     double operator()(const Board& b) const override {
-        return b.MirrorsDestroyed() + EMPTY_LINES_PARAM[b.size()-50] * b.EmptyLinesCount();
+        return b.MirrorsDestroyed() + EmptyLinesParam(b.size()) * b.EmptyLinesCount();
+    }
+
+    // engines are templated on board type, so they end up here
+    // and call final board directly, or read the score if board keeps it
+    template<class B>
+    double operator()(const B& b) const {
+        if constexpr (HasScoreValue_v1<B>::value) {
+            return b.ScoreValue_v1();
+        } else {
+            return b.MirrorsDestroyed() + EmptyLinesParam(b.size()) * b.EmptyLinesCount();
+        }
     }
 };
 
-template<class Board>
+// same as Score_v1 in fixed point, parameter is converted once per board.
+// engines keep scores as ints then, comparisons and top-K keys get cheaper
+class Score_v1_Int {
+public:
+    using CountersOnly = true_type;
+
+    template<class B>
+    IntScore operator()(const B& b) const {
+        if constexpr (HasScoreValue_v1_Int<B>::value) {
+            return b.ScoreValue_v1_Int();
+        } else {
+            return b.MirrorsDestroyed() * kScoreOne + EmptyLinesParamInt(b.size()) * b.EmptyLinesCount();
+        }
+    }
+};
+
+// Board stays for old spelling, any board type is accepted
+template<class Board = void>
 class Score_Psyho {
 public:
-    double operator()(const Board& b) const {
-        return b.MirrorsDestroyed() + (b.EmptyRowCount()+1)/(b.EmptyColCount()+1) * 8;
+    using CountersOnly = true_type;
+
+    template<class B>
+    double operator()(const B& b) const {
+        return b.MirrorsDestroyed() + (b.EmptyRowCount()+1.)/(b.EmptyColCount()+1) * 8;
+    }
+};
+
+
+// 2-ply: board is scored by its best child. children are cast in place
+// with nested CastRestorable and restored, nothing is copied.
+// engines that hold board as const get score of the board itself
+template<class S = Score_v1>
+class Score_Lookahead {
+public:
+    template<class B>
+    using ScoreValue = decltype(declval<const S&>()(declval<const B&>()));
+
+    template<class B>
+    ScoreValue<B> operator()(B& b) const {
+        static_assert(HasNestedRestore<B>::value, "children would overwrite restore of the board");
+        auto best = score_(b);
+        for (auto i = 0; i < b.RayCount(); ++i) {
+            if (b.CastRestorable(i) > 0) best = max(best, score_(b));
+            b.Restore();
+        }
+        return best;
+    }
+
+    template<class B>
+    ScoreValue<B> operator()(const B& b) const {
+        return score_(b);
     }
+
+private:
+    S score_;
 };
 
 
@@ -52,6 +156,11 @@ public:
         // may need to take into account something else
         return Score_v1()(b)/b.CastCount();
     }
+
+    template<class B>
+    double operator()(const B& b) const {
+        return Score_v1()(b)/b.CastCount();
+    }
 };
 
 
@@ -0,0 +1,111 @@
+//
+// Created by Anton Logunov on 5/10/17.
+//
+#pragma once
+
+#include <chrono>
+
+#include "util.hpp"
+
+
+// picks beam width for every next layer so that search ends at
+// deadline_ratio of the deadline.
+// work of a board is measured as in Balancer_2: RayCount * sqrt(MirrorsLeft).
+// seconds per work unit are taken from layers already done, number of layers left
+// from mirrors left and average destroyed per cast of the best board so far.
+// before the first layer both come from expansion of the root alone
+template<class BoardType>
+class TimeBalancer {
+
+    using Clock = std::chrono::steady_clock;
+
+public:
+    TimeBalancer(std::chrono::milliseconds deadline, double deadline_ratio)
+        : start_(Clock::now()), budget_(deadline_ratio * deadline.count() / 1000.) {}
+
+    // root is expanded once to see how fast it goes and how much a cast destroys
+    Count FirstBeamWidth(BoardType root, Count width) {
+        Count destroyed = 0;
+        Count casts = 0;
+        Count d_was = root.MirrorsDestroyed();
+        auto start = Clock::now();
+        root.ForEachAppliedCast([&](typename BoardType::CastType) {
+            destroyed += root.MirrorsDestroyed() - d_was;
+            ++casts;
+        });
+        UpdateRate(Seconds(Clock::now() - start) / Work(root.RayCount(), root.MirrorsLeft()));
+        if (casts == 0) return width;
+        return min(width, Width(root.RayCount(), root.MirrorsLeft(), max(1., 1. * destroyed / casts), width));
+    }
+
+    // search has to finish what it has
+    bool Over() const {
+        return Seconds(Clock::now() - start_) >= budget_;
+    }
+
+    template<class Boards>
+    void StartLayer(const Boards& bs) {
+        layer_work_ = 0;
+        for (auto& b : bs) layer_work_ += Work(b.RayCount(), b.MirrorsLeft());
+        layer_start_ = Clock::now();
+    }
+
+    template<class Boards>
+    Count NextBeamWidth(const Boards& bs, Count cur_width) {
+        if (layer_work_ > 0) UpdateRate(Seconds(Clock::now() - layer_start_) / layer_work_);
+        ++layers_done_;
+
+        double rays = 0, mirrors_left = 0;
+        Count best_destroyed = 0;
+        for (auto& b : bs) {
+            rays += b.RayCount();
+            mirrors_left += b.MirrorsLeft();
+            best_destroyed = max<Count>(best_destroyed, b.MirrorsDestroyed());
+        }
+        rays /= bs.size();
+        mirrors_left /= bs.size();
+        double destroyed_per_layer = max(1., 1. * best_destroyed / layers_done_);
+        return Width(rays, mirrors_left, destroyed_per_layer, cur_width);
+    }
+
+private:
+    Count Width(double rays, double mirrors_left, double destroyed_per_layer, Count cur_width) const {
+        double time_left = budget_ - Seconds(Clock::now() - start_);
+        if (time_left <= 0) return 1;
+        // board work of every layer left while mirrors go down linearly
+        double board_work = 0;
+        for (double m = mirrors_left; m > 0; m -= destroyed_per_layer) {
+            board_work += Work(rays, m);
+        }
+        if (board_work == 0) return cur_width;
+
+        double width = time_left / (seconds_per_work_ * board_work);
+        // early estimates are noisy, let width change gradually
+        return max<Count>(1, min(width, 2. * cur_width));
+    }
+
+    static double Work(double ray_count, double mirrors_left) {
+        return ray_count * sqrt(mirrors_left);
+    }
+
+    static double Seconds(Clock::duration d) {
+        return std::chrono::duration<double>(d).count();
+    }
+
+    void UpdateRate(double seconds_per_work) {
+        if (seconds_per_work_ == 0) {
+            seconds_per_work_ = seconds_per_work;
+        } else {
+            seconds_per_work_ = kRateSmoothing * seconds_per_work + (1 - kRateSmoothing) * seconds_per_work_;
+        }
+    }
+
+    constexpr static double kRateSmoothing = 0.3;
+
+    Clock::time_point start_;
+    Clock::time_point layer_start_;
+    double budget_;
+    double layer_work_{0};
+    double seconds_per_work_{0};
+    Count layers_done_{0};
+};
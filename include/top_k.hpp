@@ -0,0 +1,238 @@
+//
+// Created by Anton Logunov on 5/20/17.
+//
+#pragma once
+
+#include <cstring>
+
+#include "util.hpp"
+
+
+// score packed into high half and index of the item into low half.
+// bigger key means bigger score, equal scores are ordered by index
+using KeyIndex = uint64_t;
+
+// order preserving, but different doubles can get the same key.
+// TopK ranks items that share a key by the double itself
+inline uint32_t ScoreKey(double score) {
+    float f = score;
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return (u & 0x80000000u) ? ~u : (u | 0x80000000u);
+}
+
+// sign bit flipped, so unsigned order is the same
+inline uint32_t ScoreKey(int32_t score) {
+    return uint32_t(score) ^ 0x80000000u;
+}
+
+template<class ScoreValue>
+inline KeyIndex MakeKeyIndex(ScoreValue score, Index i) {
+    return (KeyIndex(ScoreKey(score)) << 32) | uint32_t(i);
+}
+
+inline Index IndexOf(KeyIndex k) {
+    return uint32_t(k);
+}
+
+
+// moves k biggest keys to the front, in no particular order,
+// keys that didn't make it are overwritten.
+// lo and hi bound all the keys.
+// every pass makes histogram over the next bits below common prefix of
+// the bounds, keys above threshold bucket are done, only keys of the
+// threshold bucket go to the next pass. ties is scratch for them.
+// passes never split keys of one score key, those are left to greater,
+// which can tell apart scores that got the same key
+template<class Greater = std::greater<KeyIndex>>
+inline void RadixSelect(vector<KeyIndex>& keys, Count k, KeyIndex lo, KeyIndex hi, vector<KeyIndex>& ties, Greater greater = Greater()) {
+    const Count kBits = 11;
+    const Count kBuckets = 1 << kBits;
+    // small ranges aren't worth the histogram
+    const Count kSmall = 256;
+
+    array<uint32_t, kBuckets> hist;
+    auto begin = keys.begin();
+    auto end = keys.end();
+    while (k > 0 && end - begin > k) {
+        if (end - begin <= kSmall || (lo >> 32) == (hi >> 32)) {
+            nth_element(begin, begin+k-1, end, greater);
+            return;
+        }
+        auto diff = lo ^ hi;
+        int high_bit = 63 - __builtin_clzll(diff);
+        int shift = max<int>(32, high_bit + 1 - kBits);
+        auto base = lo >> shift;
+        hist.fill(0);
+        for (auto it = begin; it != end; ++it) ++hist[(*it >> shift) - base];
+        // walk from the top until k is reached
+        Index t = kBuckets;
+        Count above = 0;
+        while (above + hist[--t] < k) above += hist[t];
+        // one pass: keys above go to the front, ties are put right after them
+        ties.clear();
+        auto out = begin;
+        for (auto it = begin; it != end; ++it) {
+            auto b = (*it >> shift) - base;
+            if (b > t) *out++ = *it;
+            else if (b == t) ties.push_back(*it);
+        }
+        begin = out;
+        end = copy(ties.begin(), ties.end(), out);
+        k -= above;
+        lo = (base + t) << shift;
+        hi = lo | ((KeyIndex(1) << shift) - 1);
+    }
+}
+
+inline void RadixSelect(vector<KeyIndex>& keys, Count k) {
+    if (keys.empty()) return;
+    auto mm = minmax_element(keys.begin(), keys.end());
+    vector<KeyIndex> ties;
+    RadixSelect(keys, k, *mm.first, *mm.second, ties);
+}
+
+
+// picks items with highest score keeping only packed keys while selecting,
+// items are moved once when order is known
+template<class T>
+class TopK {
+public:
+
+    // after the call items keeps only k best, in no particular order
+    template<class Score>
+    void Select(vector<T>& items, Count k, Score score) {
+        if (items.size() <= k) return;
+        Rank(items, k, score);
+        buffer_.clear();
+        for (Index i = 0; i < k; ++i) buffer_.push_back(move(items[IndexOf(keys_[i])]));
+        items.swap(buffer_);
+    }
+
+    // k best go first, rest goes after them in the same order
+    template<class Score>
+    void Split(vector<T>& items, Count k, Score score) {
+        if (items.size() <= k) return;
+        Rank(items, k, score);
+        taken_.assign(items.size(), false);
+        buffer_.clear();
+        for (Index i = 0; i < k; ++i) {
+            auto j = IndexOf(keys_[i]);
+            taken_[j] = true;
+            buffer_.push_back(move(items[j]));
+        }
+        for (Index j = 0; j < items.size(); ++j) {
+            if (!taken_[j]) buffer_.push_back(move(items[j]));
+        }
+        items.swap(buffer_);
+    }
+
+private:
+
+    template<class Score>
+    void Rank(const vector<T>& items, Count k, Score score) {
+        using ScoreValue = decay_t<decltype(score(items[0]))>;
+        constexpr bool kRounded = is_floating_point<ScoreValue>::value;
+        keys_.resize(items.size());
+        KeyIndex lo = numeric_limits<KeyIndex>::max();
+        KeyIndex hi = 0;
+        for (Index i = 0; i < items.size(); ++i) {
+            auto key = MakeKeyIndex(score(items[i]), i);
+            keys_[i] = key;
+            lo = min(lo, key);
+            hi = max(hi, key);
+        }
+        if (kRounded) {
+            // keys of different doubles can be equal, those go by the double
+            RadixSelect(keys_, k, lo, hi, ties_, [&](KeyIndex a, KeyIndex b) {
+                auto s_a = score(items[IndexOf(a)]);
+                auto s_b = score(items[IndexOf(b)]);
+                return s_a > s_b || (s_a == s_b && a > b);
+            });
+        } else {
+            RadixSelect(keys_, k, lo, hi, ties_);
+        }
+    }
+
+    vector<KeyIndex> keys_;
+    vector<KeyIndex> ties_;
+    vector<char> taken_;
+    vector<T> buffer_;
+};
+
+
+// streaming version, keeps at most capacity biggest of pushed items.
+// front is the smallest kept item
+template<class T, class Less = std::less<T>>
+class BoundedHeap {
+public:
+
+    BoundedHeap(Count capacity = 0, Less less = Less())
+        : capacity_(capacity), greater_(less) {}
+
+    void set_capacity(Count capacity) {
+        capacity_ = capacity;
+    }
+
+    Count capacity() const {
+        return capacity_;
+    }
+
+    // returns false if t didn't get in.
+    // displaced gets item that left the heap if any
+    bool Push(const T& t, T* displaced = nullptr) {
+        if (items_.size() < capacity_) {
+            items_.push_back(t);
+            push_heap(items_.begin(), items_.end(), greater_);
+            return true;
+        }
+        if (capacity_ == 0 || !greater_.less(items_.front(), t)) return false;
+        pop_heap(items_.begin(), items_.end(), greater_);
+        if (displaced) *displaced = move(items_.back());
+        items_.back() = t;
+        push_heap(items_.begin(), items_.end(), greater_);
+        return true;
+    }
+
+    bool full() const {
+        return items_.size() == capacity_;
+    }
+
+    const T& min() const {
+        return items_.front();
+    }
+
+    Count size() const {
+        return items_.size();
+    }
+
+    // items in heap order
+    const vector<T>& items() const {
+        return items_;
+    }
+
+    vector<T> Extract() {
+        vector<T> res;
+        res.swap(items_);
+        return res;
+    }
+
+    void clear() {
+        items_.clear();
+    }
+
+private:
+
+    // std heap is a max heap, reversed order keeps the smallest on top
+    struct Greater {
+        Greater(Less less) : less(less) {}
+        bool operator()(const T& t_0, const T& t_1) const {
+            return less(t_1, t_0);
+        }
+        Less less;
+    };
+
+    Count capacity_;
+    Greater greater_;
+    vector<T> items_;
+};
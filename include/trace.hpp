@@ -0,0 +1,83 @@
+//
+// Created by Anton Logunov on 5/13/17.
+//
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+#include "util.hpp"
+
+
+// build with -DFRAGMIR_TRACE=ON to see what beam engines spend time on.
+// otherwise everything inside TRACE is compiled out and traces stay empty
+#ifdef FRAGMIR_TRACE
+#define TRACE(...) __VA_ARGS__
+#else
+#define TRACE(...)
+#endif
+
+
+using TraceClock = std::chrono::steady_clock;
+
+inline double MillisSince(TraceClock::time_point start) {
+    return std::chrono::duration<double, milli>(TraceClock::now() - start).count();
+}
+
+// reduce happens deep inside boards, so it's counted per thread:
+// solves running side by side don't mix, engines with a pool add up workers
+extern thread_local Count TraceReduceCalls;
+
+
+struct LayerTrace {
+    Index layer;
+    Count width;
+    // boards expanded
+    Count boards;
+    // casts that destroyed something
+    Count children;
+    // children thrown away as already seen in the layer
+    Count dedup_hits;
+    // nth_element over children
+    double select_ms;
+    // copying selected parents into next layer, casts included
+    double copy_ms;
+    // counted differently: without pool it's reduces of the calling thread
+    // over the whole layer, with pool it's the sum over workers during
+    // expansion only. engines reduce only before expanding, so today both agree
+    Count reduce_calls;
+    double layer_ms;
+};
+
+// what one solve did, layer by layer
+class SolveTrace {
+public:
+    void clear() {
+        layers_.clear();
+    }
+
+    LayerTrace& NewLayer() {
+        layers_.push_back(LayerTrace{(Index)layers_.size()});
+        return layers_.back();
+    }
+
+    const vector<LayerTrace>& layers() const {
+        return layers_;
+    }
+
+    static void PrintHeader(ostream& out) {
+        out << "solve;layer;width;boards;children;dedup_hits;select_ms;copy_ms;reduce_calls;layer_ms" << endl;
+    }
+
+    // one ';' separated line per layer, solve tells solves apart in one file
+    void Print(ostream& out, const string& solve) const {
+        for (auto& t : layers_) {
+            out << solve << ";" << t.layer << ";" << t.width << ";" << t.boards << ";" << t.children << ";"
+                << t.dedup_hits << ";" << t.select_ms << ";" << t.copy_ms << ";" << t.reduce_calls << ";"
+                << t.layer_ms << endl;
+        }
+    }
+
+private:
+    vector<LayerTrace> layers_;
+};
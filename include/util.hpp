@@ -34,6 +34,7 @@ using StrBoard = vector<string>;
 extern default_random_engine RNG;
 
 vector<string> GenerateStringBoard(int sz);
+vector<string> GenerateStringBoard(int sz, default_random_engine& rng);
 vector<string> ReadBoard(istream& cin);
 void PrintSolution(ostream& cout, const vector<Position>& sol);
 void PrintSolution(ostream& cout, const vector<int>& sol);
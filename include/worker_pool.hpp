@@ -0,0 +1,51 @@
+//
+// Created by Anton Logunov on 5/2/17.
+//
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#include "util.hpp"
+
+
+// threads are started once and wait for jobs,
+// so it's cheap to run a job for every beam layer
+class WorkerPool {
+public:
+    using Job = function<void(Index)>;
+
+    explicit WorkerPool(Count worker_count);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // calls job with every worker index, calling thread works as worker 0.
+    // returns after all workers are done
+    void Run(const Job& job);
+
+    Count worker_count() const {
+        return threads_.size() + 1;
+    }
+
+private:
+    void Loop(Index worker);
+
+    vector<thread> threads_;
+    mutex mutex_;
+    condition_variable start_;
+    condition_variable done_;
+    const Job* job_{nullptr};
+    Count generation_{0};
+    Count running_{0};
+    bool stop_{false};
+};
+
+
+// [begin, end) part of count items that worker should process
+inline pair<Index, Index> WorkerShare(Count count, Index worker, Count worker_count) {
+    return {count * worker / worker_count, count * (worker+1) / worker_count};
+}
@@ -10,10 +10,20 @@
 
 #include "board_v5.hpp"
 #include "board_v6.hpp"
+#include "board_v7.hpp"
+#include "board_v8.hpp"
+#include "board_v9.hpp"
 
 constexpr const array<int, 5> Board_v5::kDirOpposite;
 constexpr const array<array<char, 4>, 2> Board_v5::kDirReflection;
 
 
 constexpr const array<int, 5> Board_v6::kDirOpposite;
-constexpr const array<array<char, 4>, 2> Board_v6::kDirReflection;
\ No newline at end of file
+constexpr const array<array<char, 4>, 2> Board_v6::kDirReflection;
+
+constexpr const array<array<char, 4>, 2> Board_v7::kDirReflection;
+
+constexpr const array<int, 5> Board_v8::kDirOpposite;
+constexpr const array<array<char, 4>, 2> Board_v8::kDirReflection;
+
+constexpr const array<array<char, 4>, 2> Board_v9::kDirReflection;
@@ -0,0 +1,7 @@
+//
+// Created by Anton Logunov on 5/13/17.
+//
+
+#include "trace.hpp"
+
+thread_local Count TraceReduceCalls = 0;
@@ -21,11 +21,15 @@ default_random_engine RNG;
 #endif
 
 vector<string> GenerateStringBoard(int sz) {
+    return GenerateStringBoard(sz, RNG);
+}
+
+vector<string> GenerateStringBoard(int sz, default_random_engine& rng) {
     discrete_distribution<int> distr{0.5, 0.5};
     vector<string> strBoard(sz);
     for (int i = 0; i < sz; i++) {
         for (int j = 0; j < sz; j++) {
-            strBoard[i].push_back(distr(RNG) == 0 ? 'R' : 'L');
+            strBoard[i].push_back(distr(rng) == 0 ? 'R' : 'L');
         }
     }
     return strBoard;
@@ -0,0 +1,54 @@
+//
+// Created by Anton Logunov on 5/2/17.
+//
+#include "worker_pool.hpp"
+
+
+WorkerPool::WorkerPool(Count worker_count) {
+    for (auto i = 1; i < worker_count; ++i) {
+        threads_.emplace_back(&WorkerPool::Loop, this, i);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        lock_guard<mutex> lock(mutex_);
+        stop_ = true;
+    }
+    start_.notify_all();
+    for (auto& t : threads_) {
+        t.join();
+    }
+}
+
+void WorkerPool::Run(const Job& job) {
+    {
+        lock_guard<mutex> lock(mutex_);
+        job_ = &job;
+        running_ = threads_.size();
+        ++generation_;
+    }
+    start_.notify_all();
+    job(0);
+    unique_lock<mutex> lock(mutex_);
+    done_.wait(lock, [&]() { return running_ == 0; });
+}
+
+void WorkerPool::Loop(Index worker) {
+    Count generation = 0;
+    while (true) {
+        const Job* job;
+        {
+            unique_lock<mutex> lock(mutex_);
+            start_.wait(lock, [&]() { return stop_ || generation_ != generation; });
+            if (stop_) return;
+            generation = generation_;
+            job = job_;
+        }
+        (*job)(worker);
+        {
+            lock_guard<mutex> lock(mutex_);
+            if (--running_ == 0) done_.notify_one();
+        }
+    }
+}
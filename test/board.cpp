@@ -8,10 +8,15 @@
 #include "board_v2_impl_1.hpp"
 #include "board_v5.hpp"
 #include "board_v6.hpp"
+#include "board_v6_fixed.hpp"
+#include "board_v7.hpp"
+#include "board_v8.hpp"
+#include "board_v9.hpp"
 #include "cast_history.hpp"
 #include "naive_search.hpp"
 #include "beam_search.hpp"
 #include "bs_new.hpp"
+#include "beam_search_replay.hpp"
 #include "score.hpp"
 
 
@@ -112,13 +117,19 @@ protected:
     using B_2 = Board_v2_Impl_1<CastHistory_Vector>;
     using B_3 = Board_v5;
     using B_4 = Board_v6;
+    using B_5 = Board_v7;
+    using B_6 = Board_v8;
+    using B_7 = Board_v9;
+    using B_8 = Board_v6_Fixed<50>;
 
     B_1 b_1;
     B_2 b_2;
     B_3 b_3;
     B_4 b_4;
-
-    array<Board*, 4> bs;
+    B_5 b_5;
+    B_6 b_6;
+    B_7 b_7;
+    B_8 b_8;
 
     virtual void SetUp() {
         auto b = GenerateStringBoard(50);
@@ -127,11 +138,22 @@ protected:
         b_2 = b;
         b_3 = b;
         b_4 = b;
+        b_5 = b;
+        b_6 = b;
+        b_7 = b;
+        b_8 = b;
+    }
 
-        bs[0] = &b_1;
-        bs[1] = &b_2;
-        bs[2] = &b_3;
-        bs[3] = &b_4;
+    // every board has the same casts as the first one
+    void ExpectSameHistory() {
+        auto casts = b_1.CastHistory();
+        ASSERT_EQ(casts, b_2.CastHistory());
+        ASSERT_EQ(casts, b_3.CastHistory());
+        ASSERT_EQ(casts, b_4.CastHistory());
+        ASSERT_EQ(casts, b_5.CastHistory());
+        ASSERT_EQ(casts, b_6.CastHistory());
+        ASSERT_EQ(casts, b_7.CastHistory());
+        ASSERT_EQ(casts, b_8.CastHistory());
     }
 
     template <class B>
@@ -140,10 +162,9 @@ protected:
         return NaiveSearch<B, Score>().Destroy(b, s);
     }
 
-    template <class B>
+    template <class B, class S = Score_v1>
     B beamSolve(const B& b) {
-        Score_v1 s;
-        BeamSearch<B, Score_v1> bs;
+        BeamSearch<B, S> bs;
         bs.set_beam_width(100);
         return bs.Destroy(b);
     }
@@ -155,11 +176,12 @@ TEST_F(SearchTest, NaiveSameResultAllBoards) {
     b_2 = naiveSolve(b_2);
     b_3 = naiveSolve(b_3);
     b_4 = naiveSolve(b_4);
+    b_5 = naiveSolve(b_5);
+    b_6 = naiveSolve(b_6);
+    b_7 = naiveSolve(b_7);
+    b_8 = naiveSolve(b_8);
 
-    auto casts = b_1.CastHistory();
-    for (auto b_ptr : bs) {
-        ASSERT_EQ(casts, b_ptr->CastHistory());
-    }
+    ExpectSameHistory();
 }
 
 TEST_F(SearchTest, BeamSameResultAllBoards) {
@@ -167,27 +189,247 @@ TEST_F(SearchTest, BeamSameResultAllBoards) {
     b_2 = beamSolve(b_2);
     b_3 = beamSolve(b_3);
     b_4 = beamSolve(b_4);
+    b_5 = beamSolve(b_5);
+    b_6 = beamSolve(b_6);
+    b_7 = beamSolve(b_7);
+    b_8 = beamSolve(b_8);
 
-    auto casts = b_1.CastHistory();
-    for (auto b_ptr : bs) {
-        ASSERT_EQ(casts, b_ptr->CastHistory());
-    }
+    ExpectSameHistory();
+}
+
+// boards that keep int score and the ones that don't have to agree
+TEST_F(SearchTest, IntScoreSameResultAllBoards) {
+    b_1 = beamSolve<B_1, Score_v1_Int>(b_1);
+    b_2 = beamSolve<B_2, Score_v1_Int>(b_2);
+    b_3 = beamSolve<B_3, Score_v1_Int>(b_3);
+    b_4 = beamSolve<B_4, Score_v1_Int>(b_4);
+    b_5 = beamSolve<B_5, Score_v1_Int>(b_5);
+    b_6 = beamSolve<B_6, Score_v1_Int>(b_6);
+    b_7 = beamSolve<B_7, Score_v1_Int>(b_7);
+    b_8 = beamSolve<B_8, Score_v1_Int>(b_8);
+
+    ExpectSameHistory();
 }
 
 TEST_F(SearchTest, ReduceSameResultAllBoards) {
+    // from compacting on any waste to almost never
+    b_1.set_reduce_cost(0);
     b_1 = beamSolve(b_1);
-    b_1.set_reduce_empty_ratio(0.25);
+    b_2.set_reduce_cost(1);
     b_2 = beamSolve(b_2);
-    b_2.set_reduce_empty_ratio(0.5);
+    b_3.set_reduce_cost(4);
     b_3 = beamSolve(b_3);
-    b_3.set_reduce_empty_ratio(0.75);
+    b_4.set_reduce_cost(1000);
     b_4 = beamSolve(b_4);
-    b_4.set_reduce_empty_ratio(1.);
+    b_5 = beamSolve(b_5);
+    b_6.set_reduce_cost(0);
+    b_6 = beamSolve(b_6);
+    b_7.set_reduce_cost(0);
+    b_7 = beamSolve(b_7);
+    b_8.set_reduce_cost(0);
+    b_8 = beamSolve(b_8);
+
+    ExpectSameHistory();
+}
+
+template<class B>
+void CheckNestedRestore(const StrBoard& str_board) {
+    B b = str_board;
+    b.Cast(0);
+    auto hash = b.hash();
+    auto destroyed = b.MirrorsDestroyed();
+    for (auto i = 0; i < b.RayCount(); ++i) {
+        b.CastRestorable(i);
+        auto child_hash = b.hash();
+        auto child_destroyed = b.MirrorsDestroyed();
+        for (auto j = 0; j < b.RayCount(); ++j) {
+            b.CastRestorable(j);
+            b.Restore();
+            ASSERT_EQ(child_hash, b.hash());
+            ASSERT_EQ(child_destroyed, b.MirrorsDestroyed());
+        }
+        b.Restore();
+        ASSERT_EQ(hash, b.hash());
+        ASSERT_EQ(destroyed, b.MirrorsDestroyed());
+    }
+}
+
+TEST(Board, NestedRestore) {
+    auto str_board = GenerateStringBoard(50);
+    CheckNestedRestore<Board_v5>(str_board);
+    CheckNestedRestore<Board_v6>(str_board);
+    CheckNestedRestore<Board_v6_Fixed<50>>(str_board);
+}
+
+// sizes off the list go with the dynamic board
+TEST(Board, WithBoard_v6_Fixed) {
+    auto size_of_fixed = [](const auto& b) {
+        return is_same<decay_t<decltype(b)>, Board_v6>::value ? 0 : b.size();
+    };
+    ASSERT_EQ(60, WithBoard_v6_Fixed(GenerateStringBoard(60), size_of_fixed));
+    ASSERT_EQ(0, WithBoard_v6_Fixed(GenerateStringBoard(55), size_of_fixed));
+}
+
+TEST(Score, Psyho) {
+    Board_v6 b = GenerateStringBoard(50);
+    for (auto i = 0; i < 20; ++i) b.Cast(i);
+    double expected = b.MirrorsDestroyed() + (b.EmptyRowCount()+1.)/(b.EmptyColCount()+1) * 8;
+    ASSERT_DOUBLE_EQ(expected, Score_Psyho<Board_v6>()(b));
+    ASSERT_DOUBLE_EQ(expected, Score_Psyho<>()(b));
+}
+
+// ray, hash, destroyed and empty lines of every child
+vector<tuple<short, Board_v6::HashType, Count, Count>> AppliedCasts(Board_v6& b) {
+    vector<tuple<short, Board_v6::HashType, Count, Count>> res;
+    b.ForEachAppliedCast([&](short ray) {
+        res.emplace_back(ray, b.hash(), b.MirrorsDestroyed(), b.EmptyLinesCount());
+    });
+    return res;
+}
+
+TEST(Board, RayCache) {
+    auto str_board = GenerateStringBoard(50);
+    Board_v6 b = str_board;
+    Board_v6 b_cache = str_board;
+    b_cache.EnableRayCache();
+    default_random_engine rng(0);
+    vector<short> log, log_cache;
+    vector<Count> frames;
+    while (!b.AllDestroyed()) {
+        ASSERT_EQ(AppliedCasts(b), AppliedCasts(b_cache));
+        auto ray = uniform_int_distribution<short>(0, b.RayCount()-1)(rng);
+        if (frames.size() < 3 && rng() % 2 == 0) {
+            frames.push_back(log.size());
+            b.CastLogged(ray, log);
+            b_cache.CastLogged(ray, log_cache);
+        } else if (!frames.empty()) {
+            b.UndoLogged(log, log.size() - frames.back());
+            b_cache.UndoLogged(log_cache, log_cache.size() - frames.back());
+            frames.pop_back();
+        } else {
+            b.Cast(ray);
+            b_cache.Cast(ray);
+        }
+    }
+}
+
+// every record of a ray leaves stale refs behind, lists get pruned
+TEST(RayCache, PruneStale) {
+    RayCache cache;
+    cache.Reset(4, 10);
+    vector<short> items = {5, 6};
+    for (auto i = 0; i < 1000; ++i) {
+        cache.Record(0, {}, items.begin(), items.end());
+    }
+    ASSERT_EQ(3, cache.live_ref_count());
+    ASSERT_LE(cache.ref_count(), 3 * 8);
+    cache.Drop(6);
+    ASSERT_FALSE(cache.valid(0));
+    ASSERT_EQ(0, cache.live_ref_count());
+}
+
+TEST(BeamSearch, Lookahead) {
+    auto str_board = GenerateStringBoard(50);
+    Board_v6 b = str_board;
+    BeamSearch<Board_v6, Score_Lookahead<>> s;
+    s.set_beam_width(10);
+    b = s.Destroy(b);
+    Board_v1_Impl_1<CastHistory_Nodes> s_check = str_board;
+    for (auto& p : b.CastHistory()) s_check.Cast(p);
+    ASSERT_TRUE(s_check.AllDestroyed());
+}
+
+TEST(BeamSearch, Parallel) {
+    auto str_board = GenerateStringBoard(50);
+    Board_v6 b = str_board;
+    BeamSearch<Board_v6, Score_v1> s;
+    s.set_beam_width(100);
+    s.set_thread_count(4);
+    b = s.Destroy(b);
+    auto history = b.CastHistory();
+    ASSERT_FALSE(history.empty());
+    Board_v1_Impl_1<CastHistory_Nodes> s_check = str_board;
+    for_each(history.begin(), history.end(), [&](const Position& p) {
+        s_check.Cast(p);
+    });
+    ASSERT_TRUE(s_check.AllDestroyed());
+}
+
+TEST(BeamSearch, Deadline) {
+    auto str_board = GenerateStringBoard(50);
+    Board_v6 b = str_board;
+    BeamSearch<Board_v6, Score_v1> s;
+    // way too wide to finish in time without balancer
+    s.set_beam_width(10000);
+    s.set_deadline(std::chrono::milliseconds(2000));
+    b = s.Destroy(b);
+    ASSERT_TRUE(b.AllDestroyed());
+    ASSERT_LT(s.layer_widths()[0], 10000);
+}
 
-    auto casts = b_1.CastHistory();
-    for (auto b_ptr : bs) {
-        ASSERT_EQ(casts, b_ptr->CastHistory());
+// past deadline nothing is expanded, root is finished greedily
+TEST(BeamSearch, DeadlinePassed) {
+    Board_v6 b = GenerateStringBoard(50);
+    BeamSearch<Board_v6, Score_v1> s;
+    s.set_beam_width(100);
+    s.set_deadline(std::chrono::milliseconds(0));
+    b = s.Destroy(b);
+    ASSERT_TRUE(b.AllDestroyed());
+    ASSERT_EQ(0, s.layer_count());
+}
+
+TEST(BeamSearch, Timeout) {
+    Board_v6 b = GenerateStringBoard(50);
+    BeamSearch<Board_v6, Score_v1> s;
+    s.set_beam_width(100);
+    s.set_time(std::chrono::seconds(0));
+    b = s.Destroy(b);
+    ASSERT_TRUE(b.AllDestroyed());
+}
+
+// greedy finish scores with lookahead too, steps don't always score higher
+TEST(BeamSearch, LookaheadTimeout) {
+    auto str_board = GenerateStringBoard(50);
+    Board_v6 b = str_board;
+    BeamSearch<Board_v6, Score_Lookahead<>> s;
+    s.set_beam_width(10);
+    s.set_time(std::chrono::seconds(0));
+    b = s.Destroy(b);
+    Board_v1_Impl_1<CastHistory_Nodes> s_check = str_board;
+    for (auto& p : b.CastHistory()) s_check.Cast(p);
+    ASSERT_TRUE(s_check.AllDestroyed());
+}
+
+// both go in trie order, so replay sees the same layers and finishes with the same casts
+template<class Score>
+void CheckReplay(const vector<string>& str_board, Count beam_width) {
+    Board_v6 b = str_board;
+    BeamSearch<Board_v6, Score> s;
+    s.set_beam_width(beam_width);
+    s.set_record_layers(true);
+    BeamSearchReplay<Board_v6, Score> s_replay;
+    s_replay.set_beam_width(beam_width);
+    auto b_replay = s_replay.Destroy(b);
+    b = s.Destroy(b);
+    ASSERT_EQ(s.layer_count(), s_replay.layer_count());
+    for (Index i = 0; i < s.layer_count(); ++i) {
+        ASSERT_EQ(s.layer_hashes()[i], s_replay.LayerHashes(i+1));
     }
+    ASSERT_EQ(b.CastHistory(), b_replay.CastHistory());
+    Board_v1_Impl_1<CastHistory_Nodes> s_check = str_board;
+    for (auto& p : b_replay.CastHistory()) s_check.Cast(p);
+    ASSERT_TRUE(s_check.AllDestroyed());
+}
+
+TEST(BeamSearchReplay, SameAsBeamSearch) {
+    CheckReplay<Score_v1>(GenerateStringBoard(50), 100);
+}
+
+// lookahead reads links, so working board goes without ray cache
+TEST(BeamSearchReplay, Lookahead) {
+    static_assert(IsCountersOnlyScore<Score_v1>::value, "");
+    static_assert(!IsCountersOnlyScore<Score_Lookahead<>>::value, "");
+    CheckReplay<Score_Lookahead<>>(GenerateStringBoard(50), 10);
 }
 
 TEST(BeamSearchNew, Functional) {
@@ -203,4 +445,34 @@ TEST(BeamSearchNew, Functional) {
         s_check.Cast(p);
     });
     ASSERT_TRUE(s_check.AllDestroyed());
-}
\ No newline at end of file
+}
+
+TEST(BeamSearchNew, Parallel) {
+    auto str_board = GenerateStringBoard(50);
+    Board_v6 b = str_board;
+    BeamSearchNew<Board_v6> s;
+    s.set_beam_width(100);
+    s.set_millis(2000);
+    s.set_thread_count(4);
+    b = s.Destroy(b);
+    auto history = b.CastHistory();
+    Board_v1_Impl_1<CastHistory_Nodes> s_check = str_board;
+    for_each(history.begin(), history.end(), [&](const Position& p) {
+        s_check.Cast(p);
+    });
+    ASSERT_TRUE(s_check.AllDestroyed());
+}
+
+// budget goes past a few collects of history, nodes of the solution survive them
+TEST(BeamSearchNew, CollectHistory) {
+    auto str_board = GenerateStringBoard(50);
+    Board_v6 b = str_board;
+    BeamSearchNew<Board_v6> s;
+    s.set_beam_width(100);
+    s.set_millis(60000);
+    s.set_node_budget(8000);
+    b = s.Destroy(b);
+    Board_v1_Impl_1<CastHistory_Nodes> s_check = str_board;
+    for (auto& p : b.CastHistory()) s_check.Cast(p);
+    ASSERT_TRUE(s_check.AllDestroyed());
+}
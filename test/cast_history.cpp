@@ -0,0 +1,29 @@
+//
+// Created by Anton Logunov on 5/12/17.
+//
+
+#include "gtest/gtest.h"
+
+#include "cast_history.hpp"
+
+
+TEST(CastHistory_Nodes_v2, CollectReuse) {
+    CastHistory_Nodes_v2 root;
+    root.Push({0, 0}, 0);
+    root.Detach();
+
+    vector<CastHistory_Nodes_v2> layer(2, root);
+    layer[0].Push({1, 1}, 1);
+    layer[1].Push({2, 2}, 2);
+    // second child dies
+    layer.resize(1);
+    CastHistory_Nodes_v2::Collect(layer, [](const CastHistory_Nodes_v2& h) -> auto& { return h; });
+
+    auto h = layer[0];
+    h.Push({3, 3}, 3);
+    ASSERT_EQ(3, h.Count());
+    ASSERT_EQ((vector<short>{0, 1, 3}), ToRayVector(h));
+    ASSERT_EQ((vector<Position>{{0, 0}, {1, 1}, {3, 3}}), ToVector(h));
+    // history of a board that was copied before collect is untouched
+    ASSERT_EQ((vector<short>{0}), ToRayVector(root));
+}
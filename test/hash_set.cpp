@@ -0,0 +1,44 @@
+//
+// Created by Anton Logunov on 5/4/17.
+//
+
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "hash_set.hpp"
+
+
+TEST(LayerHashSet, InsertClear) {
+    LayerHashSet s;
+    for (uint64_t k = 0; k < 10000; ++k) {
+        ASSERT_TRUE(s.insert(k));
+    }
+    ASSERT_EQ(10000, s.size());
+    ASSERT_FALSE(s.insert(5));
+    ASSERT_TRUE(s.count(9999));
+
+    s.clear();
+    ASSERT_EQ(0, s.size());
+    ASSERT_FALSE(s.count(5));
+    ASSERT_TRUE(s.insert(5));
+}
+
+TEST(LayerHashSet, InsertConcurrent) {
+    LayerHashSet s;
+    Count key_count = 100000;
+    s.reserve(key_count);
+    // every key is inserted by every thread, only one of them should succeed
+    vector<Count> inserted(4, 0);
+    vector<thread> ts;
+    for (auto t = 0; t < inserted.size(); ++t) {
+        ts.emplace_back([&, t]() {
+            for (uint64_t k = 0; k < key_count; ++k) {
+                inserted[t] += s.insert_concurrent(k);
+            }
+        });
+    }
+    for (auto& t : ts) t.join();
+    ASSERT_EQ(key_count, accumulate(inserted.begin(), inserted.end(), 0));
+    ASSERT_EQ(key_count, s.size());
+}
@@ -0,0 +1,69 @@
+//
+// Created by Anton Logunov on 5/20/17.
+//
+
+#include "gtest/gtest.h"
+
+#include "top_k.hpp"
+
+
+TEST(TopK, SameAsSort) {
+    default_random_engine rng(0);
+    // few distinct scores, so ties have to be handled
+    uniform_int_distribution<> distr(0, 50);
+    for (Count k : {1, 10, 300, 999, 1000, 1500}) {
+        vector<double> scores(1000);
+        for (auto& s : scores) s = distr(rng) / 10. - 2.;
+        auto sorted = scores;
+        sort(sorted.begin(), sorted.end(), std::greater<double>());
+        sorted.resize(min<Count>(k, sorted.size()));
+
+        TopK<double> top_k;
+        top_k.Select(scores, k, [](double s) { return s; });
+        sort(scores.begin(), scores.end(), std::greater<double>());
+        ASSERT_EQ(sorted, scores);
+    }
+}
+
+// keys are floats, but doubles that round to the same float are still ranked right
+TEST(TopK, DoublePrecision) {
+    default_random_engine rng(0);
+    vector<double> scores;
+    for (int i = 0; i < 1000; ++i) scores.push_back(100. + i * 1e-9);
+    shuffle(scores.begin(), scores.end(), rng);
+    for (Count k : {1, 10, 300}) {
+        auto items = scores;
+        auto sorted = scores;
+        sort(sorted.begin(), sorted.end(), std::greater<double>());
+        sorted.resize(k);
+
+        TopK<double> top_k;
+        top_k.Select(items, k, [](double s) { return s; });
+        sort(items.begin(), items.end(), std::greater<double>());
+        ASSERT_EQ(sorted, items);
+    }
+}
+
+TEST(BoundedHeap, KeepsBiggest) {
+    BoundedHeap<int> heap(3);
+    int displaced = -1;
+    for (int i : {5, 1, 7, 3}) heap.Push(i, &displaced);
+    ASSERT_EQ(1, displaced);
+    ASSERT_FALSE(heap.Push(2));
+    ASSERT_EQ(3, heap.min());
+    auto items = heap.Extract();
+    sort(items.begin(), items.end());
+    ASSERT_EQ((vector<int>{3, 5, 7}), items);
+}
+
+TEST(TopK, SplitKeepsRest) {
+    vector<double> scores;
+    for (int i = 0; i < 1000; ++i) scores.push_back((i * 7919) % 1000);
+    TopK<double> top_k;
+    top_k.Split(scores, 300, [](double s) { return s; });
+    ASSERT_EQ(1000, scores.size());
+    sort(scores.begin(), scores.begin()+300);
+    ASSERT_EQ(700, scores[0]);
+    ASSERT_EQ(999, scores[299]);
+    for (Index i = 300; i < 1000; ++i) ASSERT_LT(scores[i], 700);
+}